@@ -0,0 +1,137 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <pico/mutex.h>
+
+#include "Commands.h"
+#include "Configurator.h"
+#include "Constants.h"
+
+#include <vector>
+
+struct CachedAnimation {
+    String name;
+    uint16_t frameCount;
+    uint16_t ledCount;
+    // frameCount * ledCount pixels, already in the matrix's wiring order
+    CRGB *frames;
+    // Each frame's own delay in ms, 0 for the pattern's; nullptr if none has one
+    uint16_t *delays;
+    uint32_t lastUsed;
+
+    inline size_t sizeBytes() const
+    {
+        return sizeof(CRGB) * frameCount * ledCount +
+            (delays ? sizeof(uint16_t) * frameCount : 0);
+    }
+};
+
+/**
+ * @brief Keeps decoded animations in RAM so that showing a frame is a single
+ * copy instead of a LittleFS read and decode.
+ * Animations are read from /<name>.anim. One that is missing or corrupt, or
+ * too big for the budget, is remembered until clear() so it isn't read and
+ * checked again every frame; frames of a too big one are decoded one at a
+ * time straight out of its container. Either core may be rendering a port, so
+ * every public call takes the cache's lock, and frames are copied out under
+ * it rather than handed out where the other core's next load could evict them.
+ */
+class AnimationCache {
+    public:
+        explicit AnimationCache(size_t budgetBytes);
+        ~AnimationCache();
+
+        /**
+         * @brief Copy a frame of an animation, loading every frame of it if it
+         * is not resident, or decoding just this one if it can't fit
+         *
+         * @param name animation name such as "amogus"
+         * @param out must hold width * height pixels, and is left as it was
+         * if the frame doesn't exist
+         * @return false if the frame doesn't exist, which is counted in missingFrames
+         */
+        bool copyFrame(const char *name, uint16_t frame, CRGB *out,
+            const MatrixConfiguration &matrixConfig);
+
+        /**
+         * @brief How long a frame of a loaded animation asks to be shown for
+         *
+         * @return 0 if the frame has no delay of its own, or the animation
+         * isn't loaded, including one too big to cache
+         */
+        uint16_t frameDelay(const char *name, uint16_t frame);
+
+        /**
+         * @brief Which frame, counting every frame since playback started
+         * rather than wrapping, is due a time after playback started
+         *
+         * @param defaultDelayMs for frames without a delay of their own, and
+         * for every frame if the animation isn't loaded
+         */
+        uint32_t stepAt(const char *name, uint32_t elapsedMs, uint16_t defaultDelayMs);
+
+        /**
+         * @brief Drop every animation, along with which ones couldn't be loaded
+         */
+        void clear();
+
+        inline uint32_t hits() const { return _hits; }
+        inline uint32_t misses() const { return _misses; }
+        inline uint32_t evictions() const { return _evictions; }
+        inline uint32_t missingFrames() const { return _missingFrames; }
+        inline size_t usedBytes() const { return _usedBytes; }
+        inline size_t budgetBytes() const { return _budgetBytes; }
+
+    private:
+        /**
+         * @return nullptr if the frame doesn't exist or the animation can't fit
+         */
+        const CRGB *getFrame(const char *name, uint16_t frame,
+            const MatrixConfiguration &matrixConfig);
+
+        CachedAnimation *find(const char *name);
+
+        CachedAnimation *load(const char *name,
+            const MatrixConfiguration &matrixConfig);
+
+        /**
+         * @param oversized set if the container checked out but can't fit
+         */
+        CRGB *loadContainer(const char *name, uint16_t *frameCount,
+            uint16_t **delays, bool *oversized,
+            const MatrixConfiguration &matrixConfig);
+
+        /**
+         * @brief Decode one frame of /<name>.anim without reading the rest
+         *
+         * @param out must hold width * height pixels
+         * @return true if the frame was read and decoded
+         */
+        static bool decodeFrame(const char *name, uint16_t frame, CRGB *out,
+            const MatrixConfiguration &matrixConfig);
+
+        bool makeRoom(size_t bytes);
+
+        void evict(size_t index);
+
+        static String containerPath(const char *name);
+
+        static bool listed(const std::vector<String> &names, const char *name);
+
+        std::vector<CachedAnimation> _animations;
+        // Missing or corrupt containers, which will never load
+        std::vector<String> _unloadable;
+        // Containers that checked out but are bigger than the whole budget
+        std::vector<String> _oversized;
+        size_t _budgetBytes;
+        size_t _usedBytes = 0;
+        uint32_t _tick = 0;
+        uint32_t _hits = 0;
+        uint32_t _misses = 0;
+        uint32_t _evictions = 0;
+        uint32_t _missingFrames = 0;
+        mutex_t _mtx;
+};
+
+extern AnimationCache animationCache;
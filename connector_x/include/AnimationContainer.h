@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Layout of the .anim files written by tools/pack_animations.py
+ *
+ * [AnimationHeader][AnimationFrameEntry * frameCount][uint16_t palette * paletteSize][frame data]
+ *
+ * Everything after the header is covered by the CRC. Colors are RGB565 and
+ * pixels are in the same row order the bitmaps were stored in.
+ */
+namespace AnimationContainer
+{
+    constexpr char Magic[4] = {'C', 'X', 'A', 'N'};
+    constexpr uint8_t Version = 1;
+
+    enum class Encoding : uint8_t
+    {
+        // width * height RGB565 values
+        Raw565 = 0,
+        // width * height palette indexes
+        Indexed = 1,
+        // (run length, palette index) byte pairs
+        IndexedRle = 2,
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint8_t version;
+        Encoding encoding;
+        uint16_t width;
+        uint16_t height;
+        uint16_t frameCount;
+        uint16_t paletteSize;
+        uint16_t reserved;
+        // Bytes following the header
+        uint32_t dataSize;
+        uint32_t crc;
+    };
+
+    struct FrameEntry
+    {
+        // Relative to the start of the frame data
+        uint32_t offset;
+        uint16_t length;
+        // 0 means use the pattern's delay
+        uint16_t delayMs;
+    };
+
+    static_assert(sizeof(Header) == 24, "Header must match the packer");
+    static_assert(sizeof(FrameEntry) == 8, "FrameEntry must match the packer");
+
+    // Standard CRC-32 (same as zlib.crc32), only used when loading
+    static uint32_t crc32(const uint8_t *data, size_t len)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+            }
+        }
+
+        return ~crc;
+    }
+} // namespace AnimationContainer
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+struct bmp_file_header_t {
+  uint16_t signature;
+  uint32_t file_size;
+  uint16_t reserved[2];
+  uint32_t image_offset;
+};
+
+struct bmp_image_header_t {
+  uint32_t header_size;
+  uint32_t image_width;
+  uint32_t image_height;
+  uint16_t color_planes;
+  uint16_t bits_per_pixel;
+  uint32_t compression_method;
+  uint32_t image_size;
+  uint32_t horizontal_resolution;
+  uint32_t vertical_resolution;
+  uint32_t colors_in_palette;
+  uint32_t important_colors;
+};
+
+inline uint16_t read16(File &file) {
+    uint8_t buf[2];
+
+    file.readBytes((char*)buf, sizeof(uint16_t));
+
+    return (buf[1] << 8) | (buf[0] << 0);
+}
+
+inline uint32_t read32(File &file) {
+    uint8_t buf[4];
+
+    file.readBytes((char*)buf, sizeof(uint32_t));
+
+    return (buf[3] << 24) | (buf[2] << 16) | (buf[1] << 8) | (buf[0] << 0);
+}
+
+// Call delete[] on the returned value after done using
+inline uint8_t* getBitmapBytes(String filePath) {
+    File file = LittleFS.open(filePath, "r");
+    if (!file) {
+        return nullptr;
+    }
+
+    bmp_file_header_t fileHeader;
+    fileHeader.signature = read16(file);
+    fileHeader.file_size = read32(file);
+    fileHeader.reserved[0] = read16(file);
+    fileHeader.reserved[1] = read16(file);
+    fileHeader.image_offset = read32(file);
+    // Serial.printf("File size=%lu\n", fileHeader.file_size);
+    bmp_image_header_t imageHeader;
+    file.readBytes((char*)&imageHeader, sizeof(imageHeader));
+    // Serial.printf("Pos=%lu\n", file.position());
+
+    // Serial.printf("Bmp bpp=%d W=%d H=%d\n",
+    //     imageHeader.bits_per_pixel, imageHeader.image_width, imageHeader.image_height);
+
+    if (imageHeader.bits_per_pixel == 16) {
+        // Serial.printf("Offset=%lu\n", fileHeader.image_offset);
+        file.seek(fileHeader.image_offset);
+        uint32_t totalSize = imageHeader.image_width * imageHeader.image_height * (imageHeader.bits_per_pixel / 8);
+        // Serial.printf("Found good bmp with total size=%d\n", totalSize);
+        uint8_t* bytes = new uint8_t[totalSize];
+        file.readBytes((char*)bytes, totalSize);
+        // Serial.printf("Pos=%lu\n", file.position());
+
+        file.close();
+        return bytes;
+    }
+
+    file.close();
+    return nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <FastLED.h>
+
+enum class BlendMode : uint8_t
+{
+    // Replace what's below, except where the overlay is black
+    Normal = 0,
+    Add = 1,
+    Max = 2,
+    Multiply = 3,
+    Screen = 4,
+};
+
+namespace Blend
+{
+    inline uint8_t channel(uint8_t below, uint8_t above, BlendMode mode)
+    {
+        switch (mode)
+        {
+        case BlendMode::Add:
+        {
+            uint16_t sum = below + above;
+            return sum > 255 ? 255 : sum;
+        }
+
+        case BlendMode::Max:
+            return below > above ? below : above;
+
+        case BlendMode::Multiply:
+            return (below * (above + 1)) >> 8;
+
+        case BlendMode::Screen:
+            return 255 - (((255 - below) * (256 - above)) >> 8);
+
+        default:
+            return above;
+        }
+    }
+
+    /**
+     * @brief Move from below towards blended by alpha, where 255 is fully blended
+     */
+    inline uint8_t mix(uint8_t below, uint8_t blended, uint8_t alpha)
+    {
+        return below + ((((int16_t)blended - below) * (alpha + 1)) >> 8);
+    }
+
+    inline CRGB pixel(const CRGB &below, const CRGB &above, BlendMode mode, uint8_t alpha)
+    {
+        // Patterns leave unlit pixels black, so treat those as transparent
+        if (mode == BlendMode::Normal && !(above.r | above.g | above.b))
+        {
+            return below;
+        }
+
+        return CRGB(mix(below.r, channel(below.r, above.r, mode), alpha),
+                    mix(below.g, channel(below.g, above.g, mode), alpha),
+                    mix(below.b, channel(below.b, above.b, mode), alpha));
+    }
+} // namespace Blend
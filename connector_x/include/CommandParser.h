@@ -1,188 +1,315 @@
 #pragma once
 
-#include <pico/mutex.h>
-
 #include "Arduino.h"
 #include "Commands.h"
 
 namespace CommandParser
 {
-    static void parseCommand(uint8_t *buf, size_t len, Command *cmd)
+    /**
+     * @brief Copy the bytes after the type into dest. Anything the sender
+     * left off is zeroed rather than read from past the end of the frame.
+     *
+     * @return false if there are more bytes than dest holds, as there would be
+     * from a host using a newer layout; dest is still zeroed
+     */
+    template <typename T>
+    static bool copyPayload(T *dest, const uint8_t *buf, size_t len)
+    {
+        size_t available = len > 1 ? len - 1 : 0;
+
+        memset((void *)dest, 0, sizeof(T));
+        if (available > sizeof(T))
+        {
+            return false;
+        }
+
+        memcpy((void *)dest, &buf[1], available);
+        return true;
+    }
+
+    /**
+     * @brief Clear a command that has no payload
+     *
+     * @return false if anything came after the type
+     */
+    template <typename T>
+    static bool clearPayload(T *dest, size_t len)
+    {
+        *dest = {};
+        return len == 1;
+    }
+
+    /**
+     * @brief Number of elements in a [type][count][elements...] frame, clamped
+     * to what was actually received and to what the command can hold
+     */
+    static uint8_t arrayCount(const uint8_t *buf, size_t len, size_t elementSize,
+        size_t maxCount)
     {
+        if (len < 2)
+        {
+            return 0;
+        }
+
+        size_t count = buf[1];
+        size_t received = (len - 2) / elementSize;
+
+        if (count > received)
+        {
+            count = received;
+        }
+
+        return count > maxCount ? maxCount : count;
+    }
+
+    /**
+     * @brief Parse one command in place. A command longer than its layout
+     * allows comes from a host with a different protocol version, so rather
+     * than guess at its fields it's turned into an unknown command (0xff),
+     * which does nothing and is read back as 0xff.
+     *
+     * @param len bytes actually received, including the type byte
+     * @return false if the command was rejected
+     */
+    static bool parseCommand(const uint8_t *buf, size_t len, Command *cmd)
+    {
+        if (len == 0)
+        {
+            cmd->commandType = (CommandType)0xff;
+            return false;
+        }
+
         auto type = (CommandType)buf[0];
         // Serial.print("Received command type=");
         // Serial.println(buf[0]);
         cmd->commandType = type;
+        bool ok = true;
         switch (type)
         {
         case CommandType::On:
-            cmd->commandData.commandOn = {};
+            ok = clearPayload(&cmd->commandData.commandOn, len);
             break;
 
         case CommandType::Off:
-            cmd->commandData.commandOff = {};
+            ok = clearPayload(&cmd->commandData.commandOff, len);
             break;
 
         case CommandType::Pattern:
-            memcpy(&cmd->commandData.commandPattern, &buf[1], sizeof(CommandPattern));
+            ok = copyPayload(&cmd->commandData.commandPattern, buf, len);
             break;
 
         case CommandType::ChangeColor:
-            memcpy(&cmd->commandData.commandColor.red, &buf[1], sizeof(CommandColor));
+            ok = copyPayload(&cmd->commandData.commandColor, buf, len);
             break;
 
         case CommandType::ReadPatternDone:
-            cmd->commandData.commandReadPatternDone = {};
+            ok = clearPayload(&cmd->commandData.commandReadPatternDone, len);
             break;
 
         case CommandType::SetLedPort:
-            memcpy(&cmd->commandData.commandSetLedPort.port, &buf[1],
-                   sizeof(CommandSetLedPort));
+            ok = copyPayload(&cmd->commandData.commandSetLedPort, buf, len);
             break;
 
         case CommandType::DigitalSetup:
-            memcpy(&cmd->commandData.commandDigitalSetup.port, &buf[1],
-                   sizeof(CommandDigitalSetup));
+            ok = copyPayload(&cmd->commandData.commandDigitalSetup, buf, len);
             break;
 
         case CommandType::DigitalWrite:
-            memcpy(&cmd->commandData.commandDigitalWrite.port, &buf[1],
-                   sizeof(CommandDigitalWrite));
+            ok = copyPayload(&cmd->commandData.commandDigitalWrite, buf, len);
             break;
 
         case CommandType::DigitalRead:
-            memcpy(&cmd->commandData.commandDigitalRead.port, &buf[1],
-                   sizeof(CommandDigitalRead));
+            ok = copyPayload(&cmd->commandData.commandDigitalRead, buf, len);
             break;
 
         case CommandType::SetConfig:
-            memcpy(&cmd->commandData.commandSetConfig, &buf[1],
-                   sizeof(CommandSetConfig));
+            ok = copyPayload(&cmd->commandData.commandSetConfig, buf, len);
             break;
 
         case CommandType::ReadConfig:
-            cmd->commandData.commandReadConfig = {};
+            ok = clearPayload(&cmd->commandData.commandReadConfig, len);
             break;
 
         case CommandType::RadioSend:
-            memcpy(&cmd->commandData.commandRadioSend, &buf[1],
-                   sizeof(CommandRadioSend));
+            ok = copyPayload(&cmd->commandData.commandRadioSend, buf, len);
             break;
 
         case CommandType::RadioGetLatestReceived:
-            cmd->commandData.commandRadioGetLatestReceived = {};
+            ok = clearPayload(&cmd->commandData.commandRadioGetLatestReceived, len);
             break;
         
         case CommandType::GetColor:
-            cmd->commandData.commandGetColor = {};
+            ok = clearPayload(&cmd->commandData.commandGetColor, len);
             break;
 
         case CommandType::GetPort:
-            cmd->commandData.commandGetPort = {};
+            ok = clearPayload(&cmd->commandData.commandGetPort, len);
             break;
 
         case CommandType::SetPatternZone:
-            memcpy(&cmd->commandData.commandSetPatternZone.zoneIndex, &buf[1],
-                sizeof(CommandSetPatternZone));
+            ok = copyPayload(&cmd->commandData.commandSetPatternZone, buf, len);
             break;
 
         case CommandType::SetNewZones:
         {
-            uint8_t zones = buf[1];
-            cmd->commandData.commandSetNewZones.zoneCount = zones;
-            memcpy(&cmd->commandData.commandSetNewZones.zones, &buf[2],
-                zones * sizeof(NewZone));
+            auto &data = cmd->commandData.commandSetNewZones;
+            uint8_t zones = arrayCount(buf, len, sizeof(NewZone),
+                sizeof(data.zones) / sizeof(NewZone));
+            data.zoneCount = zones;
+            memcpy(&data.zones, &buf[2], zones * sizeof(NewZone));
+            ok = len <= 2 + zones * sizeof(NewZone);
             break;
         }
 
         case CommandType::SyncStates:
         {
-            uint8_t zones = buf[1];
-            cmd->commandData.commandSyncZoneStates.zoneCount = zones;
-            memcpy(&cmd->commandData.commandSyncZoneStates.zones, &buf[2],
-                zones * sizeof(uint8_t));
+            auto &data = cmd->commandData.commandSyncZoneStates;
+            uint8_t zones = arrayCount(buf, len, sizeof(uint8_t),
+                sizeof(data.zones));
+            data.zoneCount = zones;
+            memcpy(&data.zones, &buf[2], zones * sizeof(uint8_t));
+            ok = len <= 2 + zones * sizeof(uint8_t);
             break;
         }
 
-        default:
+        case CommandType::SetWave:
+            ok = copyPayload(&cmd->commandData.commandSetWave, buf, len);
             break;
-        }
-    }
-} // namespace CommandParser
 
-struct CommandDequeNode {
-    CommandDequeNode* next;
-    Command cmd;
+        case CommandType::SetPatternLayer:
+            ok = copyPayload(&cmd->commandData.commandSetPatternLayer, buf, len);
+            break;
 
-    CommandDequeNode(CommandDequeNode* after, Command command) {
-        next = after;
-        cmd = command;
-    }
-};
+        case CommandType::Batch:
+            // Its commands are split out by parseBatch
+            copyPayload(&cmd->commandData.commandBatch, buf, len);
+            break;
+
+        case CommandType::ReadI2CStats:
+            ok = clearPayload(&cmd->commandData.commandReadI2CStats, len);
+            break;
+
+        case CommandType::ReadStats:
+            ok = clearPayload(&cmd->commandData.commandReadStats, len);
+            break;
 
-class CommandDeque {
-    public:
-        CommandDeque() : _size{0}, _head{nullptr}, _tail{nullptr} {
+        case CommandType::LoadProgram:
+        {
+            auto &data = cmd->commandData.commandLoadProgram;
+            copyPayload(&data, buf, len);
+            // [type][slot][offset][last] then the code itself
+            size_t length = len > 4 ? len - 4 : 0;
+            data.length = length < sizeof(data.code) ? length : sizeof(data.code);
+            ok = length <= sizeof(data.code);
+            break;
         }
 
-        ~CommandDeque() {
-            if (!_head) {
-                return;
-            }
+        case CommandType::RadioSync:
+            ok = copyPayload(&cmd->commandData.commandRadioSync, buf, len);
+            break;
 
-            CommandDequeNode* curNode = _head;
-            while (curNode) {
-                auto* nextNode = curNode->next;
-                delete curNode;
-                curNode = nextNode;
-            }
+        case CommandType::SetZoneEpoch:
+            ok = copyPayload(&cmd->commandData.commandSetZoneEpoch, buf, len);
+            break;
+
+        case CommandType::ReadRadioStats:
+            ok = clearPayload(&cmd->commandData.commandReadRadioStats, len);
+            break;
+
+        case CommandType::RadioSendStatus:
+            ok = copyPayload(&cmd->commandData.commandRadioSendStatus, buf, len);
+            break;
+
+        default:
+            ok = false;
+            break;
         }
 
-        bool nextCommandAvailable() {
-            return _head;
+        if (!ok)
+        {
+            cmd->commandType = (CommandType)0xff;
         }
 
-        int getNextCommand(Command* outCommand) {
-            if (_size <= 0 || !_head) {
-                return -1;
-            }
+        return ok;
+    }
 
-            auto* newHead = _head->next;
-            *outCommand = _head->cmd;
-            delete _head;
-            _head = newHead;
+    /**
+     * @brief How many commands of a type a write holds: 1 or 0 for a single
+     * command, or the entries of that type in a Batch, found the same way
+     * parseBatch finds them
+     */
+    static uint8_t countCommands(const uint8_t *buf, size_t len, CommandType type)
+    {
+        if (len == 0)
+        {
+            return 0;
+        }
 
-            _size--;
+        if ((CommandType)buf[0] != CommandType::Batch)
+        {
+            return (CommandType)buf[0] == type ? 1 : 0;
+        }
 
-            if (!_head) {
-                _tail = nullptr;
+        uint8_t count = len > 1 ? buf[1] : 0;
+        uint8_t found = 0;
+        size_t pos = 2;
+
+        for (uint8_t i = 0; i < count && pos < len; i++)
+        {
+            uint8_t cmdLen = buf[pos++];
+            if (cmdLen == 0 || pos + cmdLen > len)
+            {
+                break;
             }
 
-            return size();
+            if ((CommandType)buf[pos] == type)
+            {
+                found++;
+            }
+
+            pos += cmdLen;
         }
 
-        int pushCommand(Command command) {
-            CommandDequeNode* newNode = new CommandDequeNode(nullptr, command);
+        return found;
+    }
 
-            if (!_head || !_tail) {
-                _head = newNode;
-                _tail = newNode;
-            } else {
-                _tail->next = newNode;
-                _tail = newNode;
-            }
+    /**
+     * @brief Split a Batch frame into its commands
+     *
+     * @param rejected set if an entry was rejected by parseCommand, in which
+     * case none of the batch is returned, so it's never shown half applied
+     * @return how many commands were parsed; stops at the first malformed entry
+     */
+    static uint8_t parseBatch(const uint8_t *buf, size_t len, Command *cmds,
+        uint8_t maxCount, bool *rejected = nullptr)
+    {
+        uint8_t count = len > 1 ? buf[1] : 0;
+        uint8_t parsed = 0;
+        size_t pos = 2;
 
-            _size++;
+        while (parsed < count && parsed < maxCount && pos < len)
+        {
+            uint8_t cmdLen = buf[pos++];
 
-            return size();
-        }
+            if (cmdLen == 0 || pos + cmdLen > len ||
+                (CommandType)buf[pos] == CommandType::Batch)
+            {
+                // Serial.printf("Bad batch entry %u\r\n", parsed);
+                break;
+            }
 
-        int size() {
-            return _size;
+            if (!parseCommand(&buf[pos], cmdLen, &cmds[parsed++]))
+            {
+                if (rejected)
+                {
+                    *rejected = true;
+                }
+                return 0;
+            }
+
+            pos += cmdLen;
         }
 
-    private:
-        int _size = 0;
-        CommandDequeNode* _head;
-        CommandDequeNode* _tail;
-};
\ No newline at end of file
+        return parsed;
+    }
+} // namespace CommandParser
@@ -28,7 +28,7 @@ enum class CommandType
     SetConfig = 10,
     // R
     ReadConfig = 11,
-    // W
+    // W, then R for the send's handle
     RadioSend = 12,
     // R
     RadioGetLatestReceived = 13,
@@ -42,6 +42,26 @@ enum class CommandType
     SetNewZones = 17,
     // W
     SyncStates = 18,
+    // W
+    SetWave = 19,
+    // W
+    SetPatternLayer = 20,
+    // W
+    Batch = 21,
+    // R
+    ReadI2CStats = 22,
+    // R
+    ReadStats = 23,
+    // W
+    LoadProgram = 24,
+    // W
+    RadioSync = 25,
+    // W
+    SetZoneEpoch = 26,
+    // R
+    ReadRadioStats = 27,
+    // R
+    RadioSendStatus = 28,
 };
 
 struct CommandOn
@@ -58,6 +78,9 @@ struct CommandPattern
     uint8_t pattern;
     uint8_t oneShot;
     int16_t delay;
+    // Non-zero to take the state from the time since the pattern started, so
+    // late frames skip states instead of slowing the pattern. Optional on the wire.
+    uint8_t timed;
 };
 
 struct CommandColor
@@ -114,7 +137,7 @@ struct CommandReadConfig
 
 struct CommandRadioSend
 {
-    // Message msg;
+    Message msg;
 };
 
 struct CommandRadioGetLatestReceived
@@ -154,6 +177,87 @@ struct CommandSyncZoneStates
     uint8_t zones[10];
 };
 
+// * Applies to every zone running the given wave pattern
+struct CommandSetWave
+{
+    // PatternType::SineRoll or PatternType::Breathing
+    uint8_t pattern;
+    // Cycle fraction advanced per state, in 1/256ths
+    uint8_t speed;
+    // LEDs per cycle, ignored by Breathing
+    uint16_t wavelength;
+};
+
+// * Layer 0 is the zone's base pattern; overlays are drawn on top of it in order
+struct CommandSetPatternLayer
+{
+    uint8_t layer;
+    // 0 = invisible, 255 = fully applied
+    uint8_t alpha;
+    // Follows BlendMode: 0 = normal, 1 = add, 2 = max, 3 = multiply, 4 = screen
+    uint8_t blendMode;
+};
+
+// * On the wire: [count] followed by count entries of [length][type][data...],
+// * where length covers the type byte and data. Core1 applies the batch's LED
+// * commands together, in order, before drawing its next frame. The rest
+// * (digital IO, radio) are run by core0 as the batch is parsed, in order
+// * among themselves but ahead of every LED command in it.
+struct CommandBatch
+{
+    uint8_t count;
+};
+
+struct CommandReadI2CStats
+{
+};
+
+struct CommandReadStats
+{
+};
+
+// * Programs longer than one command are sent in pieces at increasing offsets;
+// * the slot switches to the new program once the last piece arrives and it checks out
+struct CommandLoadProgram
+{
+    uint8_t slot;
+    // Where these bytes go in the program
+    uint8_t offset;
+    // Non-zero on the final piece
+    uint8_t last;
+    uint8_t code[Animation::programChunkSize];
+    // Taken from the frame length rather than sent
+    uint8_t length;
+};
+
+// * Only does anything with ENABLE_RADIO
+struct CommandRadioSync
+{
+    // Non-zero to be the board every other one takes its clock from,
+    // beaconing this often; 0 to follow beacons again
+    uint16_t beaconIntervalMs;
+};
+
+// * Boards following a master get one of these for each of its timed zones
+// * with every beacon
+struct CommandSetZoneEpoch
+{
+    // Network time the zone's base pattern started at
+    uint32_t startMs;
+    uint16_t zoneIndex;
+    uint8_t port;
+};
+
+struct CommandReadRadioStats
+{
+};
+
+struct CommandRadioSendStatus
+{
+    // From reading back RadioSend
+    uint16_t handle;
+};
+
 union CommandData
 {
     CommandOn commandOn;
@@ -174,6 +278,16 @@ union CommandData
     CommandSetPatternZone commandSetPatternZone;
     CommandSetNewZones commandSetNewZones;
     CommandSyncZoneStates commandSyncZoneStates;
+    CommandSetWave commandSetWave;
+    CommandSetPatternLayer commandSetPatternLayer;
+    CommandBatch commandBatch;
+    CommandReadI2CStats commandReadI2CStats;
+    CommandReadStats commandReadStats;
+    CommandLoadProgram commandLoadProgram;
+    CommandRadioSync commandRadioSync;
+    CommandSetZoneEpoch commandSetZoneEpoch;
+    CommandReadRadioStats commandReadRadioStats;
+    CommandRadioSendStatus commandRadioSendStatus;
 };
 
 struct Command
@@ -199,11 +313,29 @@ struct ResponseDigitalRead
 
 struct ResponseRadioLastReceived
 {
-    // Message msg;
+    Message msg;
+};
+
+// * The most recent RadioSend, once loop() has queued it
+struct ResponseRadioSend
+{
+    uint16_t handle;
 };
 
+struct ResponseRadioSendStatus
+{
+    uint16_t handle;
+    SendStatus status;
+};
+
+// * Bumped whenever a command or response layout changes. Hosts should read
+// * it back with ReadConfig before anything else; firmware from before it
+// * existed sends nothing after the command type.
+constexpr uint8_t ProtocolVersion = 1;
+
 struct ResponseReadConfiguration
 {
+    uint8_t protocolVersion;
     // Configuration config;
 };
 
@@ -217,14 +349,83 @@ struct ResponseReadPort
     uint8_t port;
 };
 
+struct ResponseReadI2CStats
+{
+    // Writes taken off the bus
+    uint32_t received;
+    // Writes thrown away because every receive slot was full
+    uint32_t dropped;
+    // Writes longer than a slot, truncated to fit
+    uint32_t overruns;
+    // Batches whose LED commands were thrown away because core1's queue
+    // couldn't take them all
+    uint32_t batchesDropped;
+    // Commands, or batches, thrown away for being longer than their layout,
+    // as from a host using a different ProtocolVersion
+    uint32_t rejected;
+};
+
+// * How long something took, in microseconds, capped at 65535
+struct TimerSnapshot
+{
+    uint16_t minUs;
+    uint16_t avgUs;
+    uint16_t maxUs;
+};
+
+struct PortStatsSnapshot
+{
+    // Pattern states that ran at least a full delay late
+    uint32_t overruns;
+    // Rendering and compositing a zone
+    TimerSnapshot render;
+    // Encoding the port's pixels for the wire
+    TimerSnapshot show;
+};
+
+static_assert(sizeof(TimerSnapshot) == 6, "TimerSnapshot is sent as is");
+static_assert(sizeof(PortStatsSnapshot) == 16, "PortStatsSnapshot is sent as is");
+
+// * Sent as is, so every byte is a field; the size is checked below.
+// * 0xFF comes back instead if stats are compiled out.
+struct ResponseReadStats
+{
+    PortStatsSnapshot ports[PinConstants::LED::NumPorts];
+    uint32_t i2cReceived;
+    uint32_t i2cDropped;
+    uint32_t queueOverflows;
+    TimerSnapshot loop1Period;
+    uint16_t queueDepth;
+    uint16_t queueHighWater;
+    // ProtocolVersion, so a host can tell which layout this is
+    uint8_t protocolVersion;
+    // Always 0; fills out the struct to its 4 byte alignment
+    uint8_t reserved;
+};
+
+static_assert(sizeof(ResponseReadStats) == 16 * PinConstants::LED::NumPorts + 24,
+    "ResponseReadStats would have padding sent as is");
+
+// * 0xFF comes back instead if the radio is compiled out
+struct ResponseReadRadioStats
+{
+    RadioStats stats;
+    TransferStats transfers;
+};
+
 union ResponseData
 {
     ResponsePatternDone responsePatternDone;
     ResponseDigitalRead responseDigitalRead;
     ResponseRadioLastReceived responseRadioLastReceived;
+    ResponseRadioSend responseRadioSend;
+    ResponseRadioSendStatus responseRadioSendStatus;
     ResponseReadConfiguration responseReadConfiguration;
     ResponseReadColor responseReadColor;
     ResponseReadPort responseReadPort;
+    ResponseReadI2CStats responseReadI2CStats;
+    ResponseReadStats responseReadStats;
+    ResponseReadRadioStats responseReadRadioStats;
 };
 
 struct Response
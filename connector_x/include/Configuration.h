@@ -26,6 +26,10 @@ static Configuration configuration = {
         },
         .brightness = 80,
         .isMatrix = false,
+        .output = {
+            .order = GRB,
+            .gamma = 2.2f,
+        },
     },
     .led1 = {
         .matrix = {
@@ -35,5 +39,9 @@ static Configuration configuration = {
         },
         .brightness = 50,
         .isMatrix = true,
+        .output = {
+            .order = GRB,
+            .gamma = 2.2f,
+        },
     }
 };
\ No newline at end of file
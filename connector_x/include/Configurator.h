@@ -7,6 +7,7 @@
 #include <string>
 
 #include "Constants.h"
+#include "OutputTransform.h"
 #include "ZoneDefinition.h"
 
 struct MatrixConfiguration
@@ -30,6 +31,9 @@ struct LedConfiguration
     MatrixConfiguration matrix;
     uint8_t brightness;
     bool isMatrix;
+    // Frames per second the port is shown at most, 0 for no limit
+    uint16_t maxFrameRate = PinConstants::LED::DefaultMaxFrameRate;
+    OutputTransform output;
 };
 
 struct Configuration
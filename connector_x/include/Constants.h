@@ -9,6 +9,10 @@ namespace PinConstants
     namespace I2C
     {
         constexpr uint8_t ReceiveBufSize = 128u;
+        // Writes that can wait for loop() to parse them; must be a power of two
+        constexpr uint8_t ReceiveSlotCount = 8u;
+        // Most commands one Batch can carry; must fit in CommandQueueSize
+        constexpr uint8_t MaxBatchCommands = 16u;
         namespace Port0
         {
             constexpr uint8_t BaseAddress = 0b0010000;
@@ -48,6 +52,15 @@ namespace PinConstants
         constexpr uint8_t AliveStatus = 19;
         constexpr uint8_t NumPorts = 2;
         constexpr uint8_t DefaultPort = 0;
+        constexpr uint32_t BitRateHz = 800000;
+        // 24 bits at 1.25us each
+        constexpr uint16_t PixelTimeUs = 30;
+        // Low time the strip needs to latch a frame (newer WS2812B parts need 280us)
+        constexpr uint16_t ResetTimeUs = 300;
+        // Upper bound on how often a port is re-transmitted
+        constexpr uint16_t DefaultMaxFrameRate = 100;
+        // Zones per port the status snapshot reports on
+        constexpr uint8_t MaxZones = 10;
     } // namespace LED
 
     namespace DIGITALIO
@@ -55,6 +68,7 @@ namespace PinConstants
         constexpr uint8_t P0 = 2;
         constexpr uint8_t P1 = 3;
         constexpr uint8_t P2 = 16;
+        constexpr uint8_t PortCount = 3;
 
         static const std::unordered_map<uint8_t, uint8_t> digitalIOMap = {
             {0, P0}, {1, P1}, {2, P2}};
@@ -72,7 +86,14 @@ namespace FFT
 {
     constexpr uint8_t AdcPin = A0;  // Pin 26
     constexpr uint8_t CaptureChannel = 0;
-    constexpr uint16_t SampleCount = 64;
+    // Samples per capture, chosen at runtime from the powers of two between
+    // these; each DMA buffer wraps at the capture size
+    constexpr uint16_t MinSampleCount = 64;
+    constexpr uint16_t MaxSampleCount = 1024;
+    // 195 Hz per bin, and a new spectrum every 5 ms
+    constexpr uint16_t DefaultSampleCount = 256;
+    // Frequency bands published, each the loudest of its share of the bins
+    constexpr uint8_t BandCount = 32;
     constexpr double SampleFrequencyHz = 50000;
     constexpr uint16_t ClockDivider = 960;  // 50kHz
 }
@@ -87,18 +108,77 @@ namespace Radio
     constexpr uint8_t Frequency = RF69_915MHZ;
     constexpr uint8_t MaxDataLen = RF69_MAX_DATA_LEN;
     constexpr uint16_t SendToAll = 0xFFFF;
+    // Messages go out as [MessageMagic][sequence][data...]
+    constexpr uint8_t MessageMagic = 0xC4;
+    constexpr uint8_t MaxMessageLen = MaxDataLen - 2;
+    // Received messages waiting for the callback; must be a power of two
+    constexpr uint8_t ReceiveQueueSize = 16;
+    // A sequence number heard again from the same sender this soon is a retry
+    constexpr uint16_t DuplicateWindowMs = 1000;
+    // Messages waiting for the radio to be free; must be a power of two
+    constexpr uint8_t SendQueueSize = 8;
+    // Recent sends whose outcome can be looked up by handle
+    constexpr uint8_t SendStatusSlots = 8;
+    // Tries after the first at a message to one team, each waiting this long for its ack
+    constexpr uint8_t SendRetries = 2;
+    constexpr uint16_t AckTimeoutMs = 40;
+    // Bits per second the RFM69 library sends at by default
+    constexpr uint32_t BitRate = 55555;
+    // Messages starting with this byte are clock sync beacons
+    constexpr uint8_t BeaconMagic = 0xC5;
+    constexpr uint16_t DefaultBeaconIntervalMs = 250;
+    // Timed zones one beacon can carry the start of
+    constexpr uint8_t MaxBeaconEpochs = 8;
+    // Clock errors bigger than this are jumped rather than slewed
+    constexpr uint32_t SyncStepUs = 50000;
+    // How far back drift is measured from before it's trusted
+    constexpr uint32_t DriftSpanUs = 10000000;
+    constexpr int32_t MaxDriftPpm = 500;
+    // Transfers carry payloads too big for one message, as
+    // [TransferMagic][id][fragment index][fragment count][flags][data...]
+    constexpr uint8_t TransferMagic = 0xC6;
+    // [TransferAckMagic][id][first missing][acked by][32 bits after first missing]
+    constexpr uint8_t TransferAckMagic = 0xC7;
+    constexpr uint8_t TransferHeaderLen = 5;
+    constexpr uint8_t FragmentLen = MaxDataLen - TransferHeaderLen;
+    constexpr uint16_t MaxTransferLen = 8192;
+    constexpr uint8_t MaxFragments = (MaxTransferLen + FragmentLen - 1) / FragmentLen;
+    // Fragments sent before the sender waits to hear which arrived
+    constexpr uint8_t TransferWindow = 8;
+    // A fragment unacked this long after it was sent is sent again
+    constexpr uint16_t RetransmitMs = 250;
+    // A transfer that makes no progress for this long is given up on
+    constexpr uint16_t TransferTimeoutMs = 3000;
+    // First byte of a transfer, saying what the rest is
+    constexpr uint8_t TransferProgram = 1;
 } // namespace Radio
 
 constexpr uint32_t UartBaudRate = 115200;
-constexpr uint8_t PatternCount = 15;
+constexpr uint8_t PatternCount = 19;
+// Commands waiting for core1; must be a power of two
+constexpr uint32_t CommandQueueSize = 32;
 
 namespace Animation
 {
-    constexpr double sineRollWidth = 10;
-    constexpr uint8_t sineRollStates = 60;
+    // Wave patterns always cycle through this many states; speed sets how many cycles that is
+    constexpr uint16_t waveStates = 256;
+    constexpr uint16_t sineRollWavelength = 20;
+    constexpr uint8_t sineRollSpeed = 4;
+    constexpr uint8_t breathingSpeed = 1;
     constexpr uint8_t chaseWidth = 5;
+    // Base pattern plus overlays
+    constexpr uint8_t maxZoneLayers = 4;
     constexpr uint16_t chaseSpacing = 10;
     constexpr uint16_t chaseRepeatWidth = chaseWidth + chaseSpacing;
+    // Enough to keep every bitmap animation in data/ decoded at once
+    constexpr uint32_t spriteCacheBudget = 48 * 1024;
+    // Pattern programs, loaded from LittleFS or over I2C
+    constexpr uint8_t programSlots = 4;
+    constexpr uint16_t programMaxSize = 128;
+    constexpr uint8_t programStackDepth = 16;
+    constexpr uint16_t programStates = 256;
+    // Bytes of a program carried by one LoadProgram command
+    constexpr uint8_t programChunkSize = 32;
 }
 
 namespace Matrix
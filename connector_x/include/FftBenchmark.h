@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace FftBenchmark
+{
+    /**
+     * @brief Run the same test signal through FixedFFT at every size it
+     * supports and print one CSV row per size and engine:
+     * size,engine,us_per_transform,snr_db,worst_error,pass
+     *
+     * Accuracy is of the magnitudes the spectrum analyzer uses, against a
+     * double precision DFT of the same windowed samples, in Q15 steps. A size
+     * passes with at least MinSnrDb and no error over MaxWorstError.
+     *
+     * Engines are q15 (FixedFFT), float (a plain radix-2 float FFT, on every
+     * platform) and, on the RP2040 only, arduinofft. Every engine is timed
+     * from the same int16 samples through FixedFFT::window to magnitudes, so
+     * rows of one size compare directly, but only within a platform: the host
+     * has an FPU and the RP2040 doesn't.
+     *
+     * Uses the cycle counter on the RP2040 and a steady clock on the host.
+     *
+     * @return false if any size failed
+     */
+    bool run(Stream &out);
+
+    constexpr double MinSnrDb = 45;
+    constexpr double MaxWorstError = 4;
+} // namespace FftBenchmark
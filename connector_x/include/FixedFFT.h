@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Constants.h"
+
+/**
+ * @brief FFT in Q15 fixed point, for a core without an FPU.
+ *
+ * Sizes are powers of two from FFT::MinSampleCount to FFT::MaxSampleCount,
+ * picked per call. Twiddles and the window come from tables of the largest
+ * size, worked out at compile time, which smaller sizes step through.
+ */
+namespace FixedFFT
+{
+    bool supports(uint16_t n);
+
+    /**
+     * @brief Apply a Hamming window to n Q15 samples in place
+     */
+    void window(int16_t *samples, uint16_t n);
+
+    /**
+     * @brief Transform n complex Q15 values in place, in order
+     *
+     * Every stage halves its results so nothing can overflow, so the output
+     * is the true transform divided by n.
+     */
+    void transform(int16_t *re, int16_t *im, uint16_t n);
+
+    uint16_t magnitude(int16_t re, int16_t im);
+} // namespace FixedFFT
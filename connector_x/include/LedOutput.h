@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include <hardware/dma.h>
+#include <hardware/pio.h>
+
+#include "Constants.h"
+#include "OutputTransform.h"
+
+/**
+ * @brief Moves a buffer of encoded pixels onto the wire without blocking.
+ * Each word holds one pixel's three bytes in wire order in its top 24 bits.
+ */
+class LedTransport {
+    public:
+        virtual ~LedTransport() = default;
+
+        virtual bool begin(uint8_t pin) = 0;
+
+        /**
+         * @brief Start sending count words. Must return immediately, and
+         * words must stay untouched until busy() goes false.
+         */
+        virtual void start(const uint32_t *words, uint16_t count) = 0;
+
+        virtual bool busy() = 0;
+};
+
+/**
+ * @brief WS2812 output through a PIO state machine fed by a DMA channel
+ */
+class PioLedTransport : public LedTransport {
+    public:
+        bool begin(uint8_t pin) override;
+
+        void start(const uint32_t *words, uint16_t count) override;
+
+        bool busy() override;
+
+    private:
+        PIO _pio;
+        uint _sm;
+        uint _dmaChannel;
+        dma_channel_config _dmaConfig;
+};
+
+struct OutputStats {
+    uint32_t sent;
+    // Frames overwritten by a newer one before the wire was free
+    uint32_t replaced;
+};
+
+/**
+ * @brief Double-buffered output for one LED port. show() encodes the pixels
+ * into the back buffer and returns; the frame goes out as soon as the
+ * previous one has finished, so rendering overlaps transmission.
+ *
+ * Encoding is where the port's OutputTransform is applied: gamma, color
+ * correction and brightness are folded into one lookup table per wire byte,
+ * so each pixel costs three lookups whatever the settings.
+ */
+class LedOutput {
+    public:
+        LedOutput() = default;
+        ~LedOutput();
+
+        /**
+         * @return false if the transport couldn't claim its hardware
+         */
+        bool begin(LedTransport *transport, uint8_t pin, CRGB *leds,
+            uint16_t count, const OutputTransform &transform);
+
+        /**
+         * @brief Queue the current pixels for sending, scaled by brightness
+         * up to the transform's maxBrightness
+         */
+        void show(uint8_t brightness = 255);
+
+        /**
+         * @brief Start the queued frame if the wire is free. Call often.
+         *
+         * @return true if a frame was started
+         */
+        bool update();
+
+        inline uint16_t size() const { return _count; }
+
+        inline const OutputStats& stats() const { return _stats; }
+
+    private:
+        void encode(uint32_t *words, uint8_t brightness);
+
+        /**
+         * @brief Refill _tables for a new brightness
+         */
+        void buildTables(uint8_t brightness);
+
+        LedTransport *_transport = nullptr;
+        CRGB *_leds = nullptr;
+        uint16_t _count = 0;
+        // Which CRGB channel goes out first, second and third
+        uint8_t _order[3] = {0, 1, 2};
+
+        OutputTransform _transform;
+        uint8_t _gamma[256];
+        // Final value of each wire byte for every channel value
+        uint8_t _tables[3][256];
+        // Brightness _tables were built for; above 255 when not built yet
+        uint16_t _tableBrightness = 256;
+
+        uint32_t *_buffers[2] = {nullptr, nullptr};
+        // Buffer currently on (or last sent to) the wire
+        uint8_t _front = 0;
+        bool _pending = false;
+        uint32_t _lastStartUs = 0;
+        // Time on the wire plus the reset/latch gap
+        uint32_t _frameTimeUs = 0;
+
+        OutputStats _stats = {};
+};
+
+extern LedOutput ledOutputs[PinConstants::LED::NumPorts];
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <FastLED.h>
+
+// * Applied to every pixel as it's sent, so patterns can work in plain linear RGB
+struct OutputTransform
+{
+    // Order the strip expects its channels in, as with FastLED.addLeds
+    EOrder order = GRB;
+    // 1.0 sends values unchanged; around 2.2 makes steps look even to the eye
+    float gamma = 1.0f;
+    // Per-channel scale for white balance or color temperature, 0xFFFFFF for none
+    uint32_t correction = 0xFFFFFF;
+    // Limit on the port's brightness, whatever it's shown at
+    uint8_t maxBrightness = 255;
+};
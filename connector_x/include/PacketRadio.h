@@ -11,32 +11,99 @@
 
 #include "Configurator.h"
 #include "Constants.h"
+#include "RadioTransfer.h"
+#include "SpscRing.h"
+#include "Timebase.h"
 
 #define ATC_RSSI -80
 
 struct Message
 {
     uint8_t data[61];
+    // At most Radio::MaxMessageLen
     uint8_t len;
     // Set to 0xFFFF to send to all
     uint16_t teamNumber;
 };
 
+struct RadioStats
+{
+    // Messages passed on to the callback
+    uint32_t received;
+    // Retries of a message that was already passed on
+    uint32_t duplicates;
+    // Messages thrown away because the receive queue was full. A full queue
+    // is passed on before more is taken, so this should stay 0.
+    uint32_t overflows;
+    // Frames that were neither a message nor a beacon
+    uint32_t unknown;
+};
+
+enum class SendStatus : uint8_t
+{
+    // Too old to still be tracked, or never handed out
+    Unknown = 0,
+    Queued = 1,
+    // On the air, or waiting for its ack
+    Sending = 2,
+    // Sent, and acked if it went to one team
+    Sent = 3,
+    // Never acked, or the queue was full
+    Failed = 4,
+};
+
+struct SendRecord
+{
+    uint16_t handle;
+    SendStatus status;
+};
+
 class PacketRadio
 {
 public:
     PacketRadio(SPIClass *spi, Configuration config,
-                std::function<void(Message)> newDataCb);
+                std::function<void(const Message *, uint8_t)> newDataCb);
 
     void init();
 
+    /**
+     * @brief Take whatever the radio has received into the receive queue,
+     * then pass everything queued to the callback in one call. Then send
+     * the next queued message or transfer fragment, if the air is clear.
+     */
     void update();
 
-    void send(Message message);
-
-    void sendToAll(Message message);
+    /**
+     * @brief Queue a message for update() to send, retrying until the team
+     * acks it. Returns without waiting for the radio.
+     *
+     * @param handle for sendStatus(), never 0. The caller hands these out, so
+     * it can give one back before the message reaches the radio.
+     */
+    void send(Message message, uint16_t handle);
+
+    /**
+     * @brief Like send(), but to every board in range, so nothing is acked
+     */
+    void sendToAll(Message message, uint16_t handle);
+
+    SendStatus sendStatus(uint16_t handle) const;
+
+    /**
+     * @brief Have update() broadcast a clock sync beacon ahead of anything
+     * queued, stamped as it goes out
+     */
+    inline void sendBeacon() { _beaconDue = true; }
+
+    /**
+     * @brief Copy out the most recent sends, Radio::SendStatusSlots of them
+     */
+    void getSendRecords(SendRecord *records) const
+    {
+        memcpy(records, _sendRecords, sizeof(_sendRecords));
+    }
 
-    Message getLastReceived();
+    inline const RadioStats &stats() const { return _stats; }
 
     inline uint16_t getTeamBySenderId(uint8_t senderId)
     {
@@ -51,7 +118,79 @@ public:
 
     void addTeam(uint16_t teamNumber) { hashTeamNumber(teamNumber); }
 
+    /**
+     * @brief Start sending a payload of up to Radio::MaxTransferLen bytes to
+     * one team, in fragments that update() sends
+     *
+     * @return false if a transfer is already being sent, or data is empty or
+     * too long
+     */
+    bool sendTransfer(uint16_t teamNumber, const uint8_t *data, uint16_t len)
+    {
+        return _transfer.send(hashTeamNumber(teamNumber), data, len);
+    }
+
+    inline bool transferring() const { return _transfer.sending(); }
+
+    /**
+     * @param cb called with the sender's team and the payload once a whole
+     * transfer has arrived
+     */
+    void onTransfer(std::function<void(uint16_t, const uint8_t *, uint16_t)> cb)
+    {
+        _transfer.onReceived([this, cb](uint8_t senderId, const uint8_t *data, uint16_t len)
+        {
+            cb(getTeamBySenderId(senderId), data, len);
+        });
+    }
+
+    inline const TransferStats &transferStats() const { return _transfer.stats(); }
+
+    /**
+     * @brief The radio address a team's board listens on
+     */
+    static uint8_t addressOf(uint16_t teamNumber)
+    {
+        uint8_t hash[20];
+        sha1((uint8_t *)&teamNumber, sizeof(teamNumber), hash);
+        uint16_t val = (hash[1] << 8) | hash[0];
+        return val % Radio::MaxRadioAddresses;
+    }
+
+    /**
+     * @brief Hand clock sync beacons to cb, with the time they arrived,
+     * instead of queueing them as messages
+     */
+    void onBeacon(std::function<void(const uint8_t *, uint8_t, uint64_t)> cb)
+    {
+        _beaconCb = cb;
+    }
+
+    /**
+     * @brief Frame a message for the air
+     *
+     * @return bytes written, at most Radio::MaxDataLen
+     */
+    static uint8_t writeFrame(uint8_t *buf, uint8_t sequence, const Message &message);
+
 private:
+    struct PendingSend
+    {
+        uint16_t handle;
+        uint8_t address;
+        uint8_t len;
+        uint8_t frame[Radio::MaxDataLen];
+    };
+
+    struct LastHeard
+    {
+        uint8_t newest;
+        // Bit i is set if newest - i has been heard, so retries that arrive
+        // after later messages are still caught
+        uint32_t heard;
+        uint32_t atMs;
+    };
+
     // Increase speed of lookups by using a cache
     // Run this for every expected team BEFORE receiving packets
     uint8_t hashTeamNumber(uint16_t teamNumber)
@@ -62,24 +201,54 @@ private:
             return cachedEl->second;
         }
 
-        uint8_t hash[20];
-        sha1((uint8_t *)&teamNumber, sizeof(teamNumber), hash);
-        uint16_t val = hash[1] << 8 + hash[0];
-        uint8_t hashVal = val % Radio::MaxRadioAddresses;
+        uint8_t hashVal = addressOf(teamNumber);
         _teamCache.insert({teamNumber, hashVal});
         _addressToTeam.insert({hashVal, teamNumber});
 
         return hashVal;
     }
 
+    /**
+     * @brief Queue the frame the radio just received, unless it's a retry
+     */
+    void receive(uint8_t senderId, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Pass everything in the receive queue to the callback
+     */
+    void deliver();
+
+    void queueSend(uint8_t address, const Message &message, uint16_t handle);
+
+    /**
+     * @brief Put the next thing on the air if it's clear, or retry a message
+     * whose ack hasn't come, without waiting for the radio either way
+     */
+    void updateSend();
+
+    void setSendStatus(uint16_t handle, SendStatus status);
+
     std::unique_ptr<RFM69_ATC> _radio;
+    RadioTransfer _transfer;
     std::unordered_map<uint16_t, uint8_t> _teamCache;
     std::unordered_map<uint8_t, uint16_t> _addressToTeam;
-    std::function<void(Message)> _cb;
+    std::function<void(const Message *, uint8_t)> _cb;
+    std::function<void(const uint8_t *, uint8_t, uint64_t)> _beaconCb;
     Configuration _config;
 
-    uint8_t _lastSenderId = 255;
-    uint8_t _lastDataLen = 0;
-    uint8_t _lastData[Radio::MaxDataLen] = {0};
-    bool _newDataFlag = false;
-};
\ No newline at end of file
+    SpscRing<Message, Radio::ReceiveQueueSize> _received;
+    // By sender address, only for senders that have been heard from
+    std::unordered_map<uint8_t, LastHeard> _lastHeard;
+    uint8_t _sequence = 0;
+    RadioStats _stats = {};
+
+    SpscRing<PendingSend, Radio::SendQueueSize> _sendQueue;
+    // The message on the air or waiting for its ack, if _sending
+    PendingSend _current = {};
+    bool _sending = false;
+    bool _beaconDue = false;
+    uint8_t _tries = 0;
+    uint32_t _sentAtMs = 0;
+    // By handle modulo the slot count
+    SendRecord _sendRecords[Radio::SendStatusSlots] = {};
+};
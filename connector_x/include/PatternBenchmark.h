@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace PatternBenchmark
+{
+    /**
+     * @brief Time every pattern in Animation::patterns over a range of LED
+     * counts and both zone directions, running each through its whole state
+     * cycle, and print one CSV row per pattern, count and direction:
+     * pattern,leds,direction,states,ns_per_led,worst_frame_us
+     *
+     * The LED loop patterns are also timed built for a plain ZoneView
+     * (generic_forward and generic_reversed), and SineRoll as it was before
+     * the wave engine, on soft-float sin (double_forward and
+     * double_reversed), for comparison. So is the SineRoll program that
+     * fills empty program slots, run by a copy of the VM that dispatches each
+     * instruction through a table of handlers (table_forward and
+     * table_reversed) rather than PatternVm::run's switch.
+     *
+     * Then, after a blank line, whole zone frames on the strip and the matrix
+     * from Configuration.h, drawn in place and through a scratch buffer:
+     * pattern,leds,direction,path,avg_frame_us,worst_frame_us
+     *
+     * Then how a zone's frame grows with its layer count, SineRoll under
+     * Breathing overlays in each blend mode:
+     * layers,leds,blend,avg_frame_us,ns_per_led,worst_frame_us
+     *
+     * Then the strip and the matrix rendered together, by one core and,
+     * on the host, by two threads sharing the frame as both cores do:
+     * cores,cpus,leds,avg_frame_us,speedup,worst_frame_us
+     * Two threads only beat one with at least two cpus.
+     *
+     * Uses the cycle counter on the RP2040 and a steady clock on the host.
+     */
+    void run(Stream &out);
+} // namespace PatternBenchmark
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Constants.h"
+#include "Timebase.h"
+#include "ZoneView.h"
+
+/**
+ * @brief Instructions for pattern programs. Each one pops its inputs off a
+ * stack of int32s and pushes its result. Immediates follow the opcode,
+ * little endian.
+ */
+enum class ProgramOp : uint8_t
+{
+    End = 0,
+    // Push the next byte, unsigned
+    Push8 = 1,
+    // Push the next two bytes, signed
+    Push16 = 2,
+
+    // Per-LED inputs
+    Index = 3,
+    Count = 4,
+    State = 5,
+    TimeMs = 6,
+    Red = 7,
+    Green = 8,
+    Blue = 9,
+
+    Dup = 10,
+    Drop = 11,
+    Swap = 12,
+    Over = 13,
+
+    Add = 14,
+    Sub = 15,
+    Mul = 16,
+    // Division and modulo by zero give 0
+    Div = 17,
+    Mod = 18,
+    // (a * b) >> 8, for scaling by a 0-255 fraction
+    Scale = 19,
+    Shl = 20,
+    Shr = 21,
+    And = 22,
+    Or = 23,
+    Xor = 24,
+    Min = 25,
+    Max = 26,
+
+    // Comparisons give 1 or 0
+    Lt = 27,
+    Gt = 28,
+    Eq = 29,
+    // cond a b -> a if cond is non-zero, otherwise b
+    Select = 30,
+
+    // Phase (65536 per cycle) to a 0-255 brightness
+    Sin = 31,
+    Tri = 32,
+
+    // r g b -> packed color, each channel clamped to 0-255
+    Rgb = 33,
+    // brightness -> the zone's color scaled by it
+    Shade = 34,
+};
+
+/**
+ * @brief A pattern written as a small stack program, run once per LED.
+ * Programs have no jumps, so every one finishes in a bounded number of steps,
+ * and they're checked once when loaded so the interpreter never has to be.
+ * A program must leave exactly one value, the packed color, on the stack.
+ */
+class PatternVm {
+    public:
+        struct Inputs {
+            int32_t index;
+            int32_t count;
+            int32_t state;
+            // Network time, the same on every synced board
+            int32_t timeMs;
+            uint32_t color;
+        };
+
+        /**
+         * @brief Check and install a program, replacing the current one
+         *
+         * @return false if the program is invalid; the current one is kept
+         */
+        bool load(const uint8_t *code, uint16_t length);
+
+        /**
+         * @brief Load a program from a LittleFS file
+         */
+        bool loadFile(const char *path);
+
+        /**
+         * @brief Add part of a program that's arriving in pieces, loading it
+         * once the last piece is in
+         *
+         * @return false if the piece doesn't fit or the finished program is invalid
+         */
+        bool write(uint16_t offset, const uint8_t *bytes, uint8_t length, bool last);
+
+        inline void clear() { _length = 0; }
+
+        inline bool loaded() const { return _length > 0; }
+
+        /**
+         * @brief Matches ExecutePatternCallback
+         */
+        template <typename View>
+        bool render(View strip, uint32_t color, uint16_t state, uint16_t ledCount) const
+        {
+            if (!loaded())
+            {
+                return false;
+            }
+
+            Inputs inputs = {
+                .index = 0,
+                .count = ledCount,
+                .state = state,
+                .timeMs = (int32_t)timebase.nowMs(),
+                .color = color,
+            };
+
+            for (uint16_t i = 0; i < ledCount; i++)
+            {
+                inputs.index = i;
+                strip[i] = run(inputs);
+            }
+
+            return true;
+        }
+
+        uint32_t run(const Inputs &inputs) const;
+
+        static bool validate(const uint8_t *code, uint16_t length);
+
+    private:
+        uint8_t _code[Animation::programMaxSize];
+        uint16_t _length = 0;
+
+        uint8_t _staging[Animation::programMaxSize];
+};
+
+extern PatternVm programs[Animation::programSlots];
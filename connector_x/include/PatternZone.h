@@ -3,16 +3,23 @@
 #include <Arduino.h>
 #include <FastLED.h>
 
+#include "Blend.h"
 #include "Commands.h"
 #include "Patterns.h"
 #include "Configurator.h"
+#include "Status.h"
+#include "Timebase.h"
 #include "ZoneDefinition.h"
+#include "ZoneView.h"
 
 #include <vector>
 #include <memory>
 #include <string>
 
 struct RunZone {
+    // step before the first state of a timed pattern is rendered
+    static constexpr uint32_t NoStep = UINT32_MAX;
+
     uint16_t index;
     bool reversed;
     uint16_t state;
@@ -20,8 +27,20 @@ struct RunZone {
     uint8_t patternIndex;
     uint32_t lastUpdateMs;
     uint16_t delay;
+    // How long the state showing now stays up: delay, unless it's an
+    // animation frame with a delay of its own
+    uint16_t frameDelay;
     bool oneShot;
     bool doneRunning;
+    // Rendered since the port was last shown
+    bool pendingShow;
+    // State follows the time since startMs instead of counting updates, so
+    // late frames skip ahead rather than slowing the pattern down
+    bool timed;
+    // Network time, so boards sharing a timebase agree on it
+    uint32_t startMs;
+    // Delays elapsed since startMs when the current state was rendered
+    uint32_t step;
 
     explicit RunZone() = default;
 
@@ -46,6 +65,8 @@ struct RunZone {
         state = 0;
         lastUpdateMs = millis();
         doneRunning = false;
+        startMs = timebase.nowMs();
+        step = NoStep;
     }
 
     void init()
@@ -53,21 +74,51 @@ struct RunZone {
         reset();
         color = 0;
         patternIndex = 0;
+        delay = 0;
+        frameDelay = 0;
+        oneShot = false;
+        pendingShow = false;
+        timed = false;
     }
 
     bool shouldUpdate() const
     {
         // Only update if enough delay has passed and pattern can be run again
-        return (millis() - lastUpdateMs >= delay) && !(oneShot && doneRunning);
+        return (millis() - lastUpdateMs >= frameDelay) && !(oneShot && doneRunning);
     }
 };
 
+struct OverlayLayer {
+    RunZone run;
+    uint8_t alpha;
+    BlendMode blend;
+    // Rendered in zone order; direction is applied when compositing
+    std::unique_ptr<CRGB[]> pixels;
+};
+
+struct ZoneLayers {
+    // Only allocated once the zone has overlays, otherwise the base pattern
+    // renders straight into the port buffer
+    std::unique_ptr<CRGB[]> base;
+    std::vector<OverlayLayer> overlays;
+};
+
+struct FrameStats {
+    uint32_t shown;
+    // Zone updates that rode along with another zone's show
+    uint32_t coalesced;
+    // Zone frames overwritten before they were ever shown
+    uint32_t dropped;
+};
+
 class PatternZone {
     public:
         explicit PatternZone(uint8_t port, uint8_t brightness,
-            CRGB *leds, uint16_t ledCount, uint16_t zoneCount = 1);
+            CRGB *leds, uint16_t ledCount, uint16_t zoneCount = 1,
+            uint16_t maxFrameRate = PinConstants::LED::DefaultMaxFrameRate);
         explicit PatternZone(uint8_t port, uint8_t brightness,
-            CRGB *leds, std::vector<ZoneDefinition> *zones);
+            CRGB *leds, std::vector<ZoneDefinition> *zones,
+            uint16_t maxFrameRate = PinConstants::LED::DefaultMaxFrameRate);
 
         /**
          * @brief Update the current zone index
@@ -77,29 +128,89 @@ class PatternZone {
          */
         bool setRunZone(uint16_t zoneIndex, bool reversed);
 
-        bool runPattern(uint16_t index, Pattern *pattern, CRGB* pixels,
-            uint32_t color, uint16_t state);
+        /**
+         * @brief Select which layer of the current zone later pattern and
+         * color changes apply to, adding overlay layers as needed
+         *
+         * @param layer 0 for the base pattern, 1+ for overlays drawn on top in order
+         * @param alpha how strongly an overlay is applied, ignored for the base
+         * @return true if successfully set
+         */
+        bool setLayer(uint8_t layer, uint8_t alpha, BlendMode blend);
+
+        bool runPattern(uint16_t index, uint8_t layer, const Pattern *pattern);
 
+        /**
+         * @brief Render any zones that are due, then show the port at most
+         * once if anything changed
+         */
         void updateZones(bool forceUpdate = false);
 
         void updateZone(uint16_t index, bool forceUpdate = false);
 
-        void setPattern(uint8_t patternIndex, uint16_t delay, bool isOneShot = false);
+        /**
+         * @return true if the layer rendered something that should be shown
+         */
+        bool updateLayer(uint16_t index, uint8_t layer, bool forceUpdate = false);
+
+        /**
+         * @brief updateLayer for a timed layer: render the state for the time
+         * since the pattern started, if it isn't the one already showing
+         */
+        bool updateTimedLayer(uint16_t index, uint8_t layer, const Pattern *pattern,
+            bool forceUpdate);
+
+        /**
+         * @brief Move when a timed zone's base pattern started, such as to
+         * the master board's epoch for it. Untimed zones are left alone.
+         *
+         * @param startMs network time
+         */
+        void setEpoch(uint16_t index, uint32_t startMs);
+
+        /**
+         * @brief Show the port if it is dirty and a frame interval has passed
+         *
+         * @return true if the LEDs were shown
+         */
+        bool flush();
+
+        /**
+         * @brief Cap how often the port is shown
+         *
+         * @param maxFrameRate frames per second, 0 for no limit
+         */
+        void setMaxFrameRate(uint16_t maxFrameRate);
+
+        inline const FrameStats& frameStats() const { return _frameStats; }
+
+        /**
+         * @brief Fill in the port's part of the status snapshot
+         */
+        void getStatus(PortStatus *status);
+
+        /**
+         * @param isTimed take the state from elapsed time rather than
+         * advancing it once per update
+         */
+        void setPattern(uint8_t patternIndex, uint16_t delay, bool isOneShot = false,
+            bool isTimed = false);
 
-        inline void setPattern(PatternType type, uint16_t delay, bool isOneShot = false)
+        inline void setPattern(PatternType type, uint16_t delay, bool isOneShot = false,
+            bool isTimed = false)
         {
-            setPattern((uint8_t)type, delay, isOneShot);
+            setPattern((uint8_t)type, delay, isOneShot, isTimed);
         }
 
         void setColor(uint32_t color);
 
-        bool incrementState(uint16_t index, Pattern *pattern);
+        bool incrementState(uint16_t index, uint8_t layer, const Pattern *pattern);
 
         inline void reset()
         {
-            for (auto& zone : *_runZones)
+            for (uint16_t i = 0; i < _runZones->size(); i++)
             {
-                zone.reset();
+                resetLayers(i);
             }
         }
 
@@ -107,12 +218,11 @@ class PatternZone {
         {
             for (uint8_t i = 0; i < count; i++)
             {
-                auto& runZone = getRunZoneFromIndex(zoneIndexes[i]);
-                runZone.reset();
+                resetLayers(zoneIndexes[i]);
             }
         }
 
-        inline Pattern *getPattern(uint8_t index) const { return &Animation::patterns[index]; }
+        inline const Pattern *getPattern(uint8_t index) const { return &Animation::patterns[index]; }
 
         std::unique_ptr<std::vector<ZoneDefinition>> _zones;
 
@@ -127,14 +237,79 @@ class PatternZone {
             return _runZones->at(index);
         }
 
+        inline ZoneLayers& getLayersFromIndex(uint16_t index)
+        {
+            return _layers->at(index);
+        }
+
+        inline RunZone& getLayerRunZone(uint16_t index, uint8_t layer)
+        {
+            return layer == 0 ?
+                getRunZoneFromIndex(index) :
+                getLayersFromIndex(index).overlays.at(layer - 1).run;
+        }
+
+        inline void resetLayers(uint16_t index)
+        {
+            getRunZoneFromIndex(index).reset();
+            publishEpoch(index);
+
+            for (auto& overlay : getLayersFromIndex(index).overlays)
+            {
+                overlay.run.reset();
+            }
+        }
+
+        /**
+         * @brief Where a layer's pattern draws: the port buffer for a lone
+         * base layer, otherwise the layer's own buffer
+         */
+        ZoneView getLayerTarget(uint16_t index, uint8_t layer);
+
+        /**
+         * @brief Blend every layer of a zone into the port buffer in one pass
+         */
+        void composite(uint16_t index);
+
+        void present(uint16_t index);
+
+        inline uint16_t getStateCount(uint16_t index, const Pattern *pattern)
+        {
+            return pattern->mode == PatternStateMode::Constant ?
+                pattern->numStates :
+                getZoneDefinitionFromIndex(index).count + pattern->numStates;
+        }
+
+        inline uint16_t getFrameDelay(const RunZone& runZone, const Pattern *pattern)
+        {
+            uint16_t delayMs = pattern->animation ?
+                animationCache.frameDelay(pattern->animation, runZone.state) : 0;
+            return delayMs ? delayMs : runZone.delay;
+        }
+
         inline uint16_t getOffsetFromLength(uint16_t index, uint16_t ledCountPerLength)
         {
             return index * ledCountPerLength;
         }
 
+        void markDirty(RunZone& runZone);
+
+        /**
+         * @brief Keep the timebase's record of when a base pattern started up
+         * to date, so the master can beacon it
+         */
+        void publishEpoch(uint16_t index);
+
         uint16_t _zoneIndex = 0;
+        uint8_t _layerIndex = 0;
         uint8_t _port;
         uint8_t _brightness;
         CRGB *_leds;
         std::unique_ptr<std::vector<RunZone>> _runZones;
+        std::unique_ptr<std::vector<ZoneLayers>> _layers;
+
+        bool _dirty = false;
+        uint32_t _lastShowUs = 0;
+        uint32_t _frameIntervalUs = 0;
+        FrameStats _frameStats = {};
 };
\ No newline at end of file
@@ -4,20 +4,28 @@
 #include <FastLED_NeoMatrix.h>
 #include <FastLED.h>
 #include <LittleFS.h>
+#include <pico/stdlib.h>
 
+#include "AnimationCache.h"
+#include "Bitmap.h"
 #include "Constants.h"
 #include "Configuration.h"
+#include "PatternVm.h"
 #include "SpectrumAnalyzer.h"
+#include "Wave.h"
+#include "ZoneView.h"
 
-#include <math.h>
+#include <algorithm>
 
 /**
  * Will be called after set delay has passed
+ * @param strip view of the zone's pixels within the port buffer
  * @param state resets to 0 after current state >= numStates
  * @returns true if LEDs should show
  */
-typedef bool (*ExecutePatternCallback)(CRGB *strip, uint32_t color,
-                                       uint16_t state, uint16_t ledCount);
+template <typename View>
+using ExecutePatternCallback = bool (*)(View strip, uint32_t color,
+                                        uint16_t state, uint16_t ledCount);
 
 enum class PatternType
 {
@@ -36,6 +44,10 @@ enum class PatternType
     Amogus = 12,
     Spectrum = 13,
     OwOEyes = 14,
+    Program0 = 15,
+    Program1 = 16,
+    Program2 = 17,
+    Program3 = 18,
 };
 
 enum class PatternStateMode
@@ -51,119 +63,53 @@ struct Pattern
     PatternStateMode mode;
     uint16_t numStates;
     uint16_t changeDelayDefault;
-    ExecutePatternCallback cb;
-};
-
-struct bmp_file_header_t {
-  uint16_t signature;
-  uint32_t file_size;
-  uint16_t reserved[2];
-  uint32_t image_offset;
-};
-
-struct bmp_image_header_t {
-  uint32_t header_size;
-  uint32_t image_width;
-  uint32_t image_height;
-  uint16_t color_planes;
-  uint16_t bits_per_pixel;
-  uint32_t compression_method;
-  uint32_t image_size;
-  uint32_t horizontal_resolution;
-  uint32_t vertical_resolution;
-  uint32_t colors_in_palette;
-  uint32_t important_colors;
-};
-
-static uint16_t read16(File &file) {
-    uint8_t buf[2];
-
-    file.readBytes((char*)buf, sizeof(uint16_t));
-
-    return (buf[1] << 8) | (buf[0] << 0);
-}
-
-static uint32_t read32(File &file) {
-    uint8_t buf[4];
-
-    file.readBytes((char*)buf, sizeof(uint32_t));
-
-    return (buf[3] << 24) | (buf[2] << 16) | (buf[1] << 8) | (buf[0] << 0);
-}
-
-// Call delete[] on the returned value after done using
-static uint8_t* getBitmapBytes(String filePath) {
-    File file = LittleFS.open(filePath, "r");
-    // Serial.printf("Pos=%lu\n", file.position());
-
-    for (uint32_t i = 0; i < 56; i++) {
-        uint8_t val;
-        file.readBytes((char*)&val, sizeof(uint8_t));
-        // Serial.printf("%X ", val);
-    }
-
-    Serial.println();
-    file.seek(0);
-
-    bmp_file_header_t fileHeader;
-    fileHeader.signature = read16(file);
-    fileHeader.file_size = read32(file);
-    fileHeader.reserved[0] = read16(file);
-    fileHeader.reserved[1] = read16(file);
-    fileHeader.image_offset = read32(file);
-    // Serial.printf("File size=%lu\n", fileHeader.file_size);
-    bmp_image_header_t imageHeader;
-    file.readBytes((char*)&imageHeader, sizeof(imageHeader));
-    // Serial.printf("Pos=%lu\n", file.position());
-
-    // Serial.printf("Bmp bpp=%d W=%d H=%d\n",
-    //     imageHeader.bits_per_pixel, imageHeader.image_width, imageHeader.image_height);
-
-    if (imageHeader.bits_per_pixel == 16) {
-        // Serial.printf("Offset=%lu\n", fileHeader.image_offset);
-        file.seek(fileHeader.image_offset);
-        uint32_t totalSize = imageHeader.image_width * imageHeader.image_height * (imageHeader.bits_per_pixel / 8);
-        Serial.printf("Found good bmp with total size=%d\n", totalSize);
-        uint8_t* bytes = new uint8_t[totalSize];
-        file.readBytes((char*)bytes, totalSize);
-        // Serial.printf("Pos=%lu\n", file.position());
-
-        file.close();
-        return bytes;
+    // The same pattern built once per zone direction, so neither per-LED loop
+    // has to look up which way the zone runs
+    ExecutePatternCallback<ForwardZoneView> forward;
+    ExecutePatternCallback<ReversedZoneView> reversed;
+    // The animation a bitmap pattern shows, whose frames can set their own delays
+    const char *animation = nullptr;
+
+    inline bool render(const ZoneView &strip, uint32_t color, uint16_t state,
+                       uint16_t ledCount) const
+    {
+        return strip.reversed() ?
+            reversed(ReversedZoneView(strip), color, state, ledCount) :
+            forward(ForwardZoneView(strip), color, state, ledCount);
     }
+};
 
-    file.close();
-    return nullptr;
-}
-
-static bool writeToMatrix(CRGB *strip, uint16_t state, String filePathPrefix, uint16_t ledCount)
+template <typename View>
+static bool writeToMatrix(View strip, uint16_t state, const char *name, uint16_t ledCount)
 {
-    FastLED_NeoMatrix *matrix = new FastLED_NeoMatrix(strip, configuration.led1.matrix.width,
-        configuration.led1.matrix.height, configuration.led1.matrix.flags);
-    if (ledCount != matrix->width() * matrix->height()) {
-        delete matrix;
+    auto& matrixConfig = configuration.led1.matrix;
+    if (ledCount != matrixConfig.width * matrixConfig.height) {
         return false;
     }
 
-    String filePath = filePathPrefix + String(state) + String(".bmp");
-    uint8_t* bytes = getBitmapBytes(filePath);
+    // Frames are cached in wiring order, so showing one is a single copy
+    if (!animationCache.copyFrame(name, state, strip.data(), matrixConfig)) {
+        // Nothing from an earlier frame is left up in its place
+        strip.clear();
+        return false;
+    }
 
-    if (bytes) {
-        matrix->drawRGBBitmap(0, 0, (uint16_t*)bytes, matrix->width(), matrix->height());
-        delete[] bytes;
+    if (strip.reversed()) {
+        std::reverse(strip.data(), strip.data() + strip.count());
     }
-    
-    delete matrix;
+
     return true;
 }
 
-static void setColorScaled(CRGB *strip, uint16_t ledNumber, byte red, byte green, byte blue, byte scaling)
+template <typename View>
+static void setColorScaled(const View &strip, uint16_t ledNumber, byte red, byte green, byte blue, byte scaling)
 {
     // Scale RGB with a common brightness parameter
     strip[ledNumber] = CRGB((red * scaling) >> 8, (green * scaling) >> 8, (blue * scaling) >> 8);
 }
 
-static void setColorScaled(CRGB *strip, uint16_t ledNumber, uint32_t color, byte scaling)
+template <typename View>
+static void setColorScaled(const View &strip, uint16_t ledNumber, uint32_t color, byte scaling)
 {
     setColorScaled(strip, ledNumber, color >> 16, (color >> 8) & 0xff, color & 0xff, scaling & 0xff);
 }
@@ -188,15 +134,18 @@ namespace Animation
         position -= 170;
         return (uint32_t)CRGB(position * 3, 255 - position * 3, 0);
     }
-    // The function signature comes from ExecutePatternCallback in Patterns.h
+    // The function signature comes from ExecutePatternCallback in Patterns.h;
+    // each one is a template so it can be built for ZoneView or either FixedZoneView
 
-    static bool executePatternNone(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternNone(View strip, uint32_t color,
                                    uint16_t state, uint16_t ledCount)
     {
         return false;
     }
 
-    static bool executePatternSetAll(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternSetAll(View strip, uint32_t color,
                                      uint16_t state, uint16_t ledCount)
     {
         for (size_t i = 0; i < ledCount; i++)
@@ -207,7 +156,8 @@ namespace Animation
         return true;
     }
 
-    static bool executePatternBlink(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternBlink(View strip, uint32_t color,
                                     uint16_t state, uint16_t ledCount)
     {
         switch (state)
@@ -231,7 +181,8 @@ namespace Animation
         }
     }
 
-    static bool executePatternRGBFade(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternRGBFade(View strip, uint32_t color,
                                       uint16_t state, uint16_t ledCount)
     {
         for (size_t i = 0; i < ledCount; i++)
@@ -241,7 +192,8 @@ namespace Animation
         return true;
     }
 
-    static bool executePatternHackerMode(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternHackerMode(View strip, uint32_t color,
                                          uint16_t state, uint16_t ledCount)
     {
         switch (state)
@@ -259,38 +211,42 @@ namespace Animation
         }
     }
 
-    static bool executePatternBreathing(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternBreathing(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        if (state > 255)
-        {
-            state = 511 - state;
-        }
+        uint16_t phase = Wave::phaseForState(state, Wave::breathing);
+        uint8_t brightness = Wave::toBrightness(Wave::triangle(phase));
+
         for (size_t i = 0; i < ledCount; i++)
         {
-            setColorScaled(strip, i, color, state & 0xff);
+            setColorScaled(strip, i, color, brightness);
         }
 
         return true;
     }
 
-    static bool executePatternSineRoll(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternSineRoll(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
+        // Scroll towards the start of the strip as the state increases
+        Wave::PhaseAccumulator accumulator = {
+            .phase = (uint16_t)-Wave::phaseForState(state, Wave::sineRoll),
+            .step = Wave::stepForWavelength(Wave::sineRoll.wavelength),
+        };
+
         for (uint16_t index = 0; index < ledCount; index++)
         {
-            double t1 = (2 * M_PI / sineRollStates) * (sineRollStates - state);
-            double t2 = (1 / sineRollWidth) * M_PI * index;
-            double brightness = sin(t2 + t1) + 1;
-            // Truncate all values < 0 to 0
-            uint8_t quantizedBrightness = 255 * (brightness / 2);
-            setColorScaled(strip, index, color, quantizedBrightness);
+            uint8_t brightness = Wave::toBrightness(Wave::sine(accumulator.next()));
+            setColorScaled(strip, index, color, brightness);
         }
 
         return true;
     }
 
-    static bool executePatternChase(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternChase(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
         uint16_t startState = chaseWidth;
@@ -309,156 +265,247 @@ namespace Animation
         return true;
     }
 
-    static bool executePatternAngryEyes(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternAngryEyes(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/angry_eyes/", ledCount);
+        return writeToMatrix(strip, state, "angry_eyes", ledCount);
     }
 
-    static bool executePatternHappyEyes(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternHappyEyes(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/happy_eyes/", ledCount);
+        return writeToMatrix(strip, state, "happy_eyes", ledCount);
     }
                                     
-    static bool executePatternBlinkingEyes(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternBlinkingEyes(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/blinking_eyes/", ledCount);
+        return writeToMatrix(strip, state, "blinking_eyes", ledCount);
     }
 
-    static bool executePatternSurprisedEyes(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternSurprisedEyes(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/surprised_eyes/", ledCount);
+        return writeToMatrix(strip, state, "surprised_eyes", ledCount);
     }
 
-    static bool executePatternAmogus(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternAmogus(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/amogus/", ledCount);
+        return writeToMatrix(strip, state, "amogus", ledCount);
     }
 
-    static bool executePatternOwOEyes(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternOwOEyes(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        return writeToMatrix(strip, state, "/owo_eyes/", ledCount);
+        return writeToMatrix(strip, state, "owo_eyes", ledCount);
     }
 
-    static bool executePatternSpectrum(CRGB *strip, uint32_t color,
+    template <typename View>
+    static bool executePatternSpectrum(View strip, uint32_t color,
                                         uint16_t state, uint16_t ledCount)
     {
-        uint16_t sampleCount = spectrum.sampleCount();
-        float *bins = nullptr;
-
-        bool entered = mutex_enter_timeout_us(&spectrumMtx, 20);
-        if (entered)
+        // The last bins each core read, redrawn when a read fails: the layer
+        // was cleared for this frame, so drawing nothing would flash it black.
+        // Either core may render the matrix, but each renders one zone at a time.
+        static SpectrumBins lastBins[2];
+        SpectrumBins &bins = lastBins[get_core_num()];
+
+        // Fails before the first capture, leaving every bar empty, or if a
+        // capture landed during every try
+        SpectrumBins latest;
+        if (spectrum.read(&latest))
         {
-            Serial.printf("In bins\n");
-            bins = new float[sampleCount];
-            memcpy(bins, spectrum.bins(), sampleCount);
-            mutex_exit(&spectrumMtx);
+            bins = latest;
+        }
+
+        FastLED_NeoMatrix matrix(strip.data(), configuration.led1.matrix.width,
+            configuration.led1.matrix.height, configuration.led1.matrix.flags);
+        if (ledCount != matrix.width() * matrix.height()) {
+            return false;
         }
 
-        if (bins)
+        matrix.fillScreen(0);
+
+        uint16_t color16 = matrix.Color24to16(color);
+        for (uint16_t col = 0; col < matrix.width(); col++)
         {
-            Serial.printf("Got bins\n");
-            FastLED_NeoMatrix *matrix = new FastLED_NeoMatrix(strip, configuration.led1.matrix.width,
-                configuration.led1.matrix.height, configuration.led1.matrix.flags);
-            if (ledCount != matrix->width() * matrix->height()) {
-                delete matrix;
-                return false;
-            }
+            // Spread the bands across however many columns there are
+            uint16_t band = col * FFT::BandCount / matrix.width();
+            int16_t height = matrix.height() * bins.bins[band];
 
-            for (uint16_t col = 0; col < matrix->width(); col++)
+            // Adafruit_GFX would still draw one pixel of an empty bar
+            if (height > 0)
             {
-                Serial.printf("Col=%d | height=%f\n", col, matrix->height() * bins[col]);
-                matrix->drawFastVLine(col, 0, matrix->height() * bins[col], matrix->Color24to16(color));
+                matrix.drawFastVLine(col, 0, height, color16);
             }
+        }
 
-            delete matrix;
-            delete[] bins;
+        if (strip.reversed()) {
+            std::reverse(strip.data(), strip.data() + strip.count());
         }
 
         return true;
     }
 
-    // ! The order of these MUST match the order in PatternType !
-    static Pattern patterns[PatternCount] = {
+    /**
+     * @brief Runs whichever program is loaded into the slot. An empty slot
+     * draws nothing and returns false, so the layer stays as runPattern
+     * cleared it and the LEDs keep their last frame until something else on
+     * the port is drawn.
+     */
+    template <uint8_t Slot, typename View>
+    static bool executePatternProgram(View strip, uint32_t color,
+                                        uint16_t state, uint16_t ledCount)
+    {
+        return programs[Slot].render(strip, color, state, ledCount);
+    }
+
+    // Checked against PatternType below
+    constexpr Pattern patterns[] = {
         {.type = PatternType::None,
          .mode = PatternStateMode::Constant,
          .numStates = 0,
          .changeDelayDefault = 0,
-         .cb = Animation::executePatternNone},
+         .forward = Animation::executePatternNone<ForwardZoneView>,
+         .reversed = Animation::executePatternNone<ReversedZoneView>},
         {.type = PatternType::SetAll,
          .mode = PatternStateMode::Constant,
          .numStates = 1,
          .changeDelayDefault = 500u,
-         .cb = Animation::executePatternSetAll},
+         .forward = Animation::executePatternSetAll<ForwardZoneView>,
+         .reversed = Animation::executePatternSetAll<ReversedZoneView>},
         {.type = PatternType::Blink,
          .mode = PatternStateMode::Constant,
          .numStates = 2,
          .changeDelayDefault = 400u,
-         .cb = Animation::executePatternBlink},
+         .forward = Animation::executePatternBlink<ForwardZoneView>,
+         .reversed = Animation::executePatternBlink<ReversedZoneView>},
         {.type = PatternType::RGBFade,
          .mode = PatternStateMode::Constant,
          .numStates = 256,
          .changeDelayDefault = 10u,
-         .cb = Animation::executePatternRGBFade},
+         .forward = Animation::executePatternRGBFade<ForwardZoneView>,
+         .reversed = Animation::executePatternRGBFade<ReversedZoneView>},
         {.type = PatternType::HackerMode,
          .mode = PatternStateMode::Constant,
          .numStates = 2,
          .changeDelayDefault = 100u,
-         .cb = Animation::executePatternHackerMode},
+         .forward = Animation::executePatternHackerMode<ForwardZoneView>,
+         .reversed = Animation::executePatternHackerMode<ReversedZoneView>},
         {.type = PatternType::Breathing,
          .mode = PatternStateMode::Constant,
-         .numStates = 512u,
-         .changeDelayDefault = 5,
-         .cb = Animation::executePatternBreathing},
+         .numStates = waveStates,
+         .changeDelayDefault = 10,
+         .forward = Animation::executePatternBreathing<ForwardZoneView>,
+         .reversed = Animation::executePatternBreathing<ReversedZoneView>},
         {.type = PatternType::SineRoll,
          .mode = PatternStateMode::Constant,
-         .numStates = sineRollStates,
+         .numStates = waveStates,
          .changeDelayDefault = 5,
-         .cb = Animation::executePatternSineRoll},
+         .forward = Animation::executePatternSineRoll<ForwardZoneView>,
+         .reversed = Animation::executePatternSineRoll<ReversedZoneView>},
         {.type = PatternType::Chase,
          .mode = PatternStateMode::LedCount,
          .numStates = chaseWidth,
          .changeDelayDefault = 20,
-         .cb = Animation::executePatternChase},
+         .forward = Animation::executePatternChase<ForwardZoneView>,
+         .reversed = Animation::executePatternChase<ReversedZoneView>},
         {.type = PatternType::AngryEyes,
          .mode = PatternStateMode::Constant,
          .numStates = 5,
          .changeDelayDefault = 1000,
-         .cb = Animation::executePatternAngryEyes},
+         .forward = Animation::executePatternAngryEyes<ForwardZoneView>,
+         .reversed = Animation::executePatternAngryEyes<ReversedZoneView>,
+         .animation = "angry_eyes"},
         {.type = PatternType::HappyEyes,
          .mode = PatternStateMode::Constant,
          .numStates = 3,
          .changeDelayDefault = 1000,
-         .cb = Animation::executePatternHappyEyes},
+         .forward = Animation::executePatternHappyEyes<ForwardZoneView>,
+         .reversed = Animation::executePatternHappyEyes<ReversedZoneView>,
+         .animation = "happy_eyes"},
         {.type = PatternType::BlinkingEyes,
          .mode = PatternStateMode::Constant,
          .numStates = 5,
          .changeDelayDefault = 1000,
-         .cb = Animation::executePatternBlinkingEyes},
+         .forward = Animation::executePatternBlinkingEyes<ForwardZoneView>,
+         .reversed = Animation::executePatternBlinkingEyes<ReversedZoneView>,
+         .animation = "blinking_eyes"},
         {.type = PatternType::SurprisedEyes,
          .mode = PatternStateMode::Constant,
          .numStates = 1,
          .changeDelayDefault = 1000,
-         .cb = Animation::executePatternSurprisedEyes},
+         .forward = Animation::executePatternSurprisedEyes<ForwardZoneView>,
+         .reversed = Animation::executePatternSurprisedEyes<ReversedZoneView>,
+         .animation = "surprised_eyes"},
          {.type = PatternType::Amogus,
          .mode = PatternStateMode::Constant,
          .numStates = 41,
          .changeDelayDefault = 125,
-         .cb = Animation::executePatternAmogus},
+         .forward = Animation::executePatternAmogus<ForwardZoneView>,
+         .reversed = Animation::executePatternAmogus<ReversedZoneView>,
+         .animation = "amogus"},
          {.type = PatternType::Spectrum,
          .mode = PatternStateMode::Constant,
          .numStates = 1,
          .changeDelayDefault = 50,
-         .cb = Animation::executePatternSpectrum},
+         .forward = Animation::executePatternSpectrum<ForwardZoneView>,
+         .reversed = Animation::executePatternSpectrum<ReversedZoneView>},
          {.type = PatternType::OwOEyes,
          .mode = PatternStateMode::Constant,
          .numStates = 7,
          .changeDelayDefault = 750,
-         .cb = Animation::executePatternOwOEyes},
+         .forward = Animation::executePatternOwOEyes<ForwardZoneView>,
+         .reversed = Animation::executePatternOwOEyes<ReversedZoneView>,
+         .animation = "owo_eyes"},
+         {.type = PatternType::Program0,
+         .mode = PatternStateMode::Constant,
+         .numStates = programStates,
+         .changeDelayDefault = 20,
+         .forward = Animation::executePatternProgram<0, ForwardZoneView>,
+         .reversed = Animation::executePatternProgram<0, ReversedZoneView>},
+         {.type = PatternType::Program1,
+         .mode = PatternStateMode::Constant,
+         .numStates = programStates,
+         .changeDelayDefault = 20,
+         .forward = Animation::executePatternProgram<1, ForwardZoneView>,
+         .reversed = Animation::executePatternProgram<1, ReversedZoneView>},
+         {.type = PatternType::Program2,
+         .mode = PatternStateMode::Constant,
+         .numStates = programStates,
+         .changeDelayDefault = 20,
+         .forward = Animation::executePatternProgram<2, ForwardZoneView>,
+         .reversed = Animation::executePatternProgram<2, ReversedZoneView>},
+         {.type = PatternType::Program3,
+         .mode = PatternStateMode::Constant,
+         .numStates = programStates,
+         .changeDelayDefault = 20,
+         .forward = Animation::executePatternProgram<3, ForwardZoneView>,
+         .reversed = Animation::executePatternProgram<3, ReversedZoneView>},
     };
+
+    constexpr bool patternsMatchTypes()
+    {
+        for (uint8_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++)
+        {
+            if ((uint8_t)patterns[i].type != i || !patterns[i].forward || !patterns[i].reversed)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static_assert(sizeof(patterns) / sizeof(patterns[0]) == PatternCount,
+        "patterns must have an entry for every PatternType");
+    static_assert(patternsMatchTypes(),
+        "patterns must be in PatternType order, with both directions built");
 } // namespace Animation
\ No newline at end of file
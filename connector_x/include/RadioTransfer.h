@@ -0,0 +1,153 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <bitset>
+#include <functional>
+
+#include "Constants.h"
+
+struct TransferStats
+{
+    // Transfers every fragment of was acked
+    uint32_t sent;
+    // Transfers put back together and passed on
+    uint32_t received;
+    // Transfers given up on, sending or receiving
+    uint32_t failed;
+    // Fragments sent, including retransmits
+    uint32_t fragments;
+    uint32_t retransmits;
+};
+
+/**
+ * @brief Carries payloads of up to Radio::MaxTransferLen bytes between two
+ * boards, split into fragments that each fit in one packet.
+ *
+ * The sender keeps up to Radio::TransferWindow fragments in flight and asks
+ * for an ack only on the last one it sends in a row. The ack says which
+ * fragments have arrived, so only the missing ones are sent again: straight
+ * away if they were sent before the one acked, or once Radio::RetransmitMs
+ * has passed. One transfer can be sent and one received at a time.
+ *
+ * Knows nothing about the radio itself, so the simulator can run the far
+ * end of a transfer with the same code.
+ */
+class RadioTransfer {
+    public:
+        /**
+         * @param sendFrame puts one frame of at most Radio::MaxDataLen bytes
+         * on the air to a radio address
+         */
+        RadioTransfer(std::function<void(uint8_t, const uint8_t *, uint8_t)> sendFrame);
+
+        /**
+         * @brief Start sending a copy of data. update() does the sending.
+         *
+         * @return false if a transfer is already being sent, or data is empty
+         * or longer than Radio::MaxTransferLen
+         */
+        bool send(uint8_t address, const uint8_t *data, uint16_t len);
+
+        inline bool sending() const { return _out.active; }
+
+        /**
+         * @return true if update() has a fragment to send now
+         */
+        bool ready(uint32_t nowMs) const;
+
+        /**
+         * @brief Send at most one fragment that is due, and give up on
+         * transfers that have stopped making progress
+         */
+        void update(uint32_t nowMs);
+
+        /**
+         * @brief Take a frame the radio received
+         *
+         * @return false if it wasn't a transfer frame, and is left to the caller
+         */
+        bool receive(uint8_t senderId, const uint8_t *data, uint8_t len, uint32_t nowMs);
+
+        /**
+         * @param cb called with the sender's address and the payload once every
+         * fragment of a transfer has arrived
+         */
+        inline void onReceived(std::function<void(uint8_t, const uint8_t *, uint16_t)> cb)
+        {
+            _receivedCb = cb;
+        }
+
+        inline const TransferStats &stats() const { return _stats; }
+
+        static inline bool isTransfer(const uint8_t *data, uint8_t len)
+        {
+            return len > 0 &&
+                (data[0] == Radio::TransferMagic || data[0] == Radio::TransferAckMagic);
+        }
+
+    private:
+        struct Outgoing
+        {
+            bool active;
+            uint8_t address;
+            uint8_t id;
+            uint8_t count;
+            // First fragment not yet acked
+            uint8_t base;
+            uint16_t len;
+            uint32_t progressMs;
+            std::bitset<Radio::MaxFragments> acked;
+            std::bitset<Radio::MaxFragments> sent;
+            // Known lost, so due again without waiting out RetransmitMs
+            std::bitset<Radio::MaxFragments> lost;
+            // By fragment index modulo the window, for fragments in the window
+            uint32_t sentAtMs[Radio::TransferWindow];
+            // When each was last sent, counted in fragments sent
+            uint32_t order[Radio::TransferWindow];
+        };
+
+        struct Incoming
+        {
+            bool active;
+            // Passed on already; kept to ack retries
+            bool complete;
+            uint8_t sender;
+            uint8_t id;
+            uint8_t count;
+            // First fragment not yet received
+            uint8_t next;
+            uint16_t len;
+            uint32_t progressMs;
+            std::bitset<Radio::MaxFragments> have;
+        };
+
+        void receiveFragment(uint8_t senderId, const uint8_t *data, uint8_t len, uint32_t nowMs);
+
+        void receiveAck(uint8_t senderId, const uint8_t *data, uint8_t len, uint32_t nowMs);
+
+        void sendAck(uint8_t trigger);
+
+        /**
+         * @return true if fragment index should go out now
+         */
+        bool due(uint8_t index, uint32_t nowMs) const;
+
+        /**
+         * @param more set if another fragment after it is also due
+         * @return the first fragment in the window that's due, or -1
+         */
+        int16_t nextDue(uint32_t nowMs, bool *more) const;
+
+        std::function<void(uint8_t, const uint8_t *, uint8_t)> _sendFrame;
+        std::function<void(uint8_t, const uint8_t *, uint16_t)> _receivedCb;
+
+        Outgoing _out = {};
+        Incoming _in = {};
+        uint8_t _nextId = 0;
+        uint32_t _sendCount = 0;
+        TransferStats _stats = {};
+
+        uint8_t _outData[Radio::MaxTransferLen];
+        uint8_t _inData[Radio::MaxTransferLen];
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+#include <pico/stdlib.h>
+
+#include <atomic>
+
+/**
+ * @brief Shares one frame's render jobs between the two cores. Core1 opens a
+ * frame once it has applied its commands, either core claims jobs until
+ * there are none left, and core1 waits for every job to finish before it
+ * touches the zones again. A job is only ever run by one core per frame.
+ *
+ * A job may run on either core, so whatever it touches outside its own port
+ * has to allow for that: Timebase's clock is read lock-free, the animation
+ * cache takes its own lock, Spectrum keeps its last good bins per core, and
+ * each core writes only its own portStats.
+ *
+ * @tparam JobCount jobs in every frame
+ */
+template <uint8_t JobCount>
+class RenderScheduler {
+    public:
+        typedef void (*Job)(uint8_t index);
+
+        explicit RenderScheduler(Job job) : _job(job)
+        {
+        }
+
+        /**
+         * @brief Core1 only. Makes every job but the first claimable.
+         */
+        void open()
+        {
+            _done.store(0, std::memory_order_relaxed);
+            // Everything core1 wrote before this is visible to whoever claims a job
+            _next.store(1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Either core. Claims and runs the next job, if there is one.
+         *
+         * @return false if every job in the frame has been claimed
+         */
+        bool runOne()
+        {
+            // Skips the atomic add when idle, which is most of the time on core0
+            if (_next.load(std::memory_order_relaxed) >= JobCount)
+            {
+                return false;
+            }
+
+            uint32_t index = _next.fetch_add(1, std::memory_order_acq_rel);
+            if (index >= JobCount)
+            {
+                return false;
+            }
+
+            _job(index);
+            _done.fetch_add(1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief Core1 only. Runs job 0 and whatever hasn't been claimed,
+         * then waits for the jobs the other core took.
+         */
+        void finish()
+        {
+            _job(0);
+            _done.fetch_add(1, std::memory_order_relaxed);
+
+            while (runOne())
+            {
+            }
+
+            while (_done.load(std::memory_order_acquire) < JobCount)
+            {
+                tight_loop_contents();
+            }
+        }
+
+    private:
+        Job _job;
+        // Start closed, so nothing is claimed before the first open()
+        std::atomic<uint32_t> _next{JobCount};
+        std::atomic<uint32_t> _done{JobCount};
+};
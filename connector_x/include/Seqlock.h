@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+/**
+ * @brief A value one writer keeps publishing and any reader, including an
+ * interrupt on the writer's own core, can copy out without locking.
+ *
+ * There are two copies. The writer fills the one readers aren't pointed at,
+ * then points them at it, so a read only has to be retried if the writer
+ * got all the way round to the copy being read while it was being read.
+ * Reads give up after a few tries rather than spin, which an interrupt
+ * that has stopped the writer mid-write could do forever.
+ */
+template <typename T>
+class Seqlock {
+    public:
+        static constexpr uint8_t MaxReadAttempts = 3;
+
+        /**
+         * @brief Writer side only
+         *
+         * @param fill writes the new value into the T it's given, which
+         * still holds the value from two writes ago
+         */
+        template <typename F>
+        void write(F fill)
+        {
+            uint32_t next = _published.load(std::memory_order_relaxed) + 1;
+
+            _writing.store(next, std::memory_order_relaxed);
+            // Readers must see _writing move before any of the copy changes
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            fill(_copies[next & 1]);
+
+            _published.store(next, std::memory_order_release);
+        }
+
+        /**
+         * @param copy takes what it needs from the const T it's given
+         * @return false if the writer kept changing the value, and what was
+         * copied can't be used
+         */
+        template <typename F>
+        bool read(F copy) const
+        {
+            for (uint8_t attempt = 0; attempt < MaxReadAttempts; attempt++)
+            {
+                uint32_t published = _published.load(std::memory_order_acquire);
+
+                copy(_copies[published & 1]);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // Only a write after the next one reuses this copy
+                if (_writing.load(std::memory_order_relaxed) - published <= 1)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        std::atomic<uint32_t> _published{0};
+        std::atomic<uint32_t> _writing{0};
+        T _copies[2] = {};
+};
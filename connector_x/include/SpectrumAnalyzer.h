@@ -1,51 +1,76 @@
 #pragma once
 
 #include <Arduino.h>
-#include <arduinoFFT.h>
-
-#include <memory>
 
 #include <pico/stdlib.h>
 #include <hardware/adc.h>
 #include <hardware/dma.h>
 
 #include "Constants.h"
+#include "Seqlock.h"
+
+// Uncomment to sample the microphone. Its pin is also I2C address switch 0.
+// #define ENABLE_SPECTRUM
+
+struct SpectrumBins
+{
+  // Each band's magnitude, 0 to 1 of a full scale sine
+  float bins[FFT::BandCount];
+  // Counts up with every capture transformed
+  uint32_t frame;
+};
 
+/**
+ * @brief Samples the microphone without gaps and publishes its spectrum.
+ *
+ * Two DMA channels, each chained to the other, fill two buffers in turn so
+ * the ADC never stops: while one buffer fills, update() transforms the other.
+ * Each channel's writes wrap around its own buffer, so neither has to be
+ * restarted. The transform is FixedFFT's, in Q15, as the core has no FPU.
+ * The newest spectrum goes out through a Seqlock, so any number of zones on
+ * either core can copy it without locking or allocating.
+ */
 class SpectrumAnalyzer
 {
   public:
-    /**
-     * @brief Construct a new Spectrum Analyzer object
-     * 
-     * @param irq Call dmaHandler in the function
-     */
-    SpectrumAnalyzer();
-    ~SpectrumAnalyzer();
     void init(void);
     void startSampling(void);
-    void dmaHandler(void);
+    void stopSampling(void);
     /**
-     * @brief USE A MUTEX AROUND THIS
-     * 
+     * @brief Transform the newest full buffer, if one has filled since the
+     * last call. Never waits on the DMA.
      */
     void update(void);
+    /**
+     * @brief Change the capture size, restarting sampling if it's running.
+     * Larger captures resolve closer frequencies but come less often.
+     *
+     * @return false if FixedFFT doesn't support the size
+     */
+    bool setSampleCount(uint16_t count);
     uint16_t sampleCount(void) const;
     /**
-     * @brief USE A MUTEX AROUND THIS
-     * 
-     * @return float* A pointer to the resulting FFT bins
+     * @return false if nothing has been published yet, or it kept changing
+     * while being copied
+     */
+    bool read(SpectrumBins *bins) const;
+    /**
+     * @return captures that were overwritten before update() got to them
      */
-    float* bins() const;
+    inline uint32_t skipped() const { return skippedCount; }
 
   private:
-    dma_channel_config cfg;
-    uint dmaChannel;
-    float *vReal;
-    float *vImag;
-    uint8_t *adcBuf;
-    volatile bool hasData = false;
-    std::unique_ptr<ArduinoFFT<float>> fft;
+    dma_channel_config cfg[2];
+    uint dmaChannels[2];
+    uint16_t samples = FFT::DefaultSampleCount;
+    bool sampling = false;
+    // Aligned to the largest capture so the DMA's write ring wraps on each
+    alignas(FFT::MaxSampleCount) uint8_t adcBufs[2][FFT::MaxSampleCount];
+    int16_t re[FFT::MaxSampleCount];
+    int16_t im[FFT::MaxSampleCount];
+    Seqlock<SpectrumBins> published;
+    uint32_t frame = 0;
+    uint32_t skippedCount = 0;
 };
 
-static mutex_t spectrumMtx;
-static SpectrumAnalyzer spectrum{};
\ No newline at end of file
+extern SpectrumAnalyzer spectrum;
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+/**
+ * @brief Fixed-size, lock-free queue for exactly one producer and one consumer,
+ * such as core0 handing commands to core1. Nothing is allocated after construction.
+ *
+ * @tparam Capacity must be a power of two
+ */
+template <typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+        "Capacity must be a power of two");
+
+    public:
+        /**
+         * @brief Producer side only
+         *
+         * @return false if the ring was full and the item was dropped
+         */
+        bool push(const T &item)
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            uint32_t tail = _tail.load(std::memory_order_acquire);
+
+            if (head - tail >= Capacity)
+            {
+                _overflows++;
+                return false;
+            }
+
+            _items[head & (Capacity - 1)] = item;
+            _head.store(head + 1, std::memory_order_release);
+
+            uint32_t depth = head + 1 - tail;
+            if (depth > _highWater)
+            {
+                _highWater = depth;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Producer side only. The consumer sees either all of the items
+         * or none of them.
+         *
+         * @return false if they didn't all fit, in which case none were added
+         */
+        bool push(const T *items, uint32_t count)
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            uint32_t tail = _tail.load(std::memory_order_acquire);
+
+            if (Capacity - (head - tail) < count)
+            {
+                _overflows += count;
+                return false;
+            }
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _items[(head + i) & (Capacity - 1)] = items[i];
+            }
+            _head.store(head + count, std::memory_order_release);
+
+            uint32_t depth = head + count - tail;
+            if (depth > _highWater)
+            {
+                _highWater = depth;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Consumer side only
+         *
+         * @return false if there was nothing to take
+         */
+        bool pop(T *outItem)
+        {
+            uint32_t tail = _tail.load(std::memory_order_relaxed);
+            uint32_t head = _head.load(std::memory_order_acquire);
+
+            if (head == tail)
+            {
+                return false;
+            }
+
+            *outItem = _items[tail & (Capacity - 1)];
+            _tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief Producer side only. Hands out the next free slot to be filled
+         * in place; it isn't visible to the consumer until publish().
+         *
+         * @return nullptr if the ring is full
+         */
+        T *claim()
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            uint32_t tail = _tail.load(std::memory_order_acquire);
+
+            if (head - tail >= Capacity)
+            {
+                _overflows++;
+                return nullptr;
+            }
+
+            return &_items[head & (Capacity - 1)];
+        }
+
+        /**
+         * @brief Producer side only. Makes the slot from claim() visible.
+         */
+        void publish()
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed) + 1;
+            _head.store(head, std::memory_order_release);
+
+            uint32_t depth = head - _tail.load(std::memory_order_acquire);
+            if (depth > _highWater)
+            {
+                _highWater = depth;
+            }
+        }
+
+        /**
+         * @brief Consumer side only. The oldest item, still in the ring, to be
+         * read in place until release().
+         *
+         * @return nullptr if the ring is empty
+         */
+        T *front()
+        {
+            uint32_t tail = _tail.load(std::memory_order_relaxed);
+            uint32_t head = _head.load(std::memory_order_acquire);
+
+            if (head == tail)
+            {
+                return nullptr;
+            }
+
+            return &_items[tail & (Capacity - 1)];
+        }
+
+        /**
+         * @brief Consumer side only. Frees the slot from front().
+         */
+        void release()
+        {
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+        }
+
+        inline uint32_t size() const
+        {
+            return _head.load(std::memory_order_acquire) -
+                _tail.load(std::memory_order_acquire);
+        }
+
+        inline bool empty() const { return size() == 0; }
+
+        inline uint32_t capacity() const { return Capacity; }
+
+        inline uint32_t overflows() const { return _overflows; }
+
+        inline uint32_t highWater() const { return _highWater; }
+
+    private:
+        // Keep each side's index apart so the two cores never write the same line
+        static constexpr size_t LineSize = 32;
+
+        // Written only by the producer
+        alignas(LineSize) std::atomic<uint32_t> _head{0};
+        uint32_t _overflows = 0;
+        uint32_t _highWater = 0;
+
+        // Written only by the consumer
+        alignas(LineSize) std::atomic<uint32_t> _tail{0};
+
+        alignas(LineSize) T _items[Capacity];
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Arduino.h>
+#include <pico/stdlib.h>
+
+#include "Constants.h"
+
+// Comment out to compile every counter and timer below out of the firmware
+#define ENABLE_STATS
+
+/**
+ * @brief Min, average and max of a duration, in microseconds
+ */
+class StatTimer {
+    public:
+        /**
+         * @return the time to later pass to stop()
+         */
+        static inline uint32_t start()
+        {
+#ifdef ENABLE_STATS
+            return micros();
+#else
+            return 0;
+#endif
+        }
+
+        inline void stop(uint32_t startUs)
+        {
+#ifdef ENABLE_STATS
+            add(micros() - startUs);
+#endif
+        }
+
+        /**
+         * @brief Record the time since the previous lap(), for measuring a
+         * loop's period
+         */
+        inline void lap()
+        {
+#ifdef ENABLE_STATS
+            uint32_t now = micros();
+            if (_lastLapUs != 0)
+            {
+                add(now - _lastLapUs);
+            }
+            _lastLapUs = now;
+#endif
+        }
+
+        inline void add(uint32_t us)
+        {
+#ifdef ENABLE_STATS
+            _count++;
+            _totalUs += us;
+            _minUs = us < _minUs ? us : _minUs;
+            _maxUs = us > _maxUs ? us : _maxUs;
+#endif
+        }
+
+        /**
+         * @brief Fold in another timer's durations, such as the same
+         * timer's from the other core
+         */
+        inline void merge(const StatTimer &other)
+        {
+#ifdef ENABLE_STATS
+            _count += other._count;
+            _totalUs += other._totalUs;
+            _minUs = other._minUs < _minUs ? other._minUs : _minUs;
+            _maxUs = other._maxUs > _maxUs ? other._maxUs : _maxUs;
+#endif
+        }
+
+#ifdef ENABLE_STATS
+        inline uint16_t minUs() const { return _count ? saturate(_minUs) : 0; }
+
+        inline uint16_t avgUs() const { return _count ? saturate(_totalUs / _count) : 0; }
+
+        inline uint16_t maxUs() const { return saturate(_maxUs); }
+
+    private:
+        static inline uint16_t saturate(uint64_t us)
+        {
+            return us > 0xffff ? 0xffff : us;
+        }
+
+        uint32_t _count = 0;
+        uint64_t _totalUs = 0;
+        uint32_t _minUs = UINT32_MAX;
+        uint32_t _maxUs = 0;
+        uint32_t _lastLapUs = 0;
+#endif
+};
+
+class StatCounter {
+    public:
+        inline void increment()
+        {
+#ifdef ENABLE_STATS
+            _value++;
+#endif
+        }
+
+#ifdef ENABLE_STATS
+        inline uint32_t value() const { return _value; }
+
+    private:
+        uint32_t _value = 0;
+#endif
+};
+
+struct PortStats {
+    // Rendering every due layer of a zone and compositing them
+    StatTimer render;
+    // Encoding the port's pixels for the wire
+    StatTimer show;
+    // Pattern states that ran at least a full delay late
+    StatCounter overruns;
+};
+
+/**
+ * @brief Either core may render a port, so each core keeps its own stats and
+ * never writes the other's. A reader on the other core, or an interrupt, can
+ * still catch one update half done, so an average may be a sample out.
+ */
+extern PortStats portStats[2][PinConstants::LED::NumPorts];
+
+/**
+ * @brief The calling core's stats for a port
+ */
+inline PortStats &localPortStats(uint8_t port)
+{
+    return portStats[get_core_num()][port];
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Constants.h"
+#include "PacketRadio.h"
+
+struct ZoneStatus
+{
+    uint32_t color;
+    uint16_t state;
+    uint8_t pattern;
+    uint8_t done;
+};
+
+// * Each zone's base layer
+struct PortStatus
+{
+    // The zone commands currently apply to
+    uint16_t zoneIndex;
+    uint8_t zoneCount;
+    ZoneStatus zones[PinConstants::LED::MaxZones];
+};
+
+// * Published by core1 after every render pass, when no port is mid-render
+struct RenderStatus
+{
+    uint8_t ledPort;
+    PortStatus ports[PinConstants::LED::NumPorts];
+};
+
+// * Published by core0 from loop()
+struct IoStatus
+{
+    // As of the last pass of loop()
+    uint8_t digital[PinConstants::DIGITALIO::PortCount];
+    // Newest message the radio has passed on
+    Message lastRadioMessage;
+    RadioStats radioStats;
+    TransferStats transferStats;
+    SendRecord sends[Radio::SendStatusSlots];
+};
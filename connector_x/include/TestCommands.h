@@ -65,6 +65,7 @@ static std::vector<TestCommand> testCommands =
                     .pattern = 12,
                     .oneShot = 0,
                     .delay = -1,
+                    .timed = 0,
                 },
             },
         },
@@ -114,6 +115,7 @@ static std::vector<TestCommand> testCommands =
                     .pattern = 7,
                     .oneShot = 0,
                     .delay = 50,
+                    .timed = 0,
                 },
             },
         },
@@ -152,6 +154,7 @@ static std::vector<TestCommand> testCommands =
                     .pattern = 6,
                     .oneShot = 0,
                     .delay = 50,
+                    .timed = 0,
                 },
             },
         },
@@ -190,6 +193,7 @@ static std::vector<TestCommand> testCommands =
                     .pattern = 3,
                     .oneShot = 0,
                     .delay = 20,
+                    .timed = 0,
                 },
             },
         },
@@ -228,6 +232,7 @@ static std::vector<TestCommand> testCommands =
                     .pattern = 2,
                     .oneShot = 0,
                     .delay = 600,
+                    .timed = 0,
                 },
             },
         },
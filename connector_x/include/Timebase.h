@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <pico/mutex.h>
+
+#include "Constants.h"
+#include "Seqlock.h"
+
+/**
+ * @brief When a timed zone's base pattern started, in network milliseconds
+ */
+struct ZoneEpoch
+{
+    uint32_t startMs;
+    uint8_t port;
+    uint8_t zone;
+};
+
+/**
+ * @brief The clock timed patterns run on, shared by every board in radio range.
+ *
+ * One board is the master and broadcasts beacons with its clock and the start
+ * of each of its timed zones. Every other board maps its own clock onto the
+ * master's, correcting the offset on each beacon and the rate from how far
+ * the two clocks drift apart, so the same pattern started at the same epoch
+ * shows the same state on every board at once. Until a beacon is heard the
+ * network time is the local time.
+ *
+ * Beacons are [magic][count][master time, 8 bytes] followed by count
+ * [port][zone][start ms, 4 bytes] entries, all little-endian.
+ */
+class Timebase {
+    public:
+        void begin();
+
+        /**
+         * @brief Lock-free, so every pattern render on either core can call it
+         *
+         * @param localUs from time_us_64()
+         */
+        uint64_t toNetworkUs(uint64_t localUs);
+
+        uint64_t nowUs();
+
+        inline uint32_t nowMs() { return nowUs() / 1000; }
+
+        /**
+         * @brief Take the master's clock from a beacon. Ignored by the master.
+         *
+         * @param masterUs the master's network time when it sent the beacon
+         * @param localUs when the beacon finished arriving
+         */
+        void correct(uint64_t masterUs, uint64_t localUs);
+
+        /**
+         * @brief Stop following beacons and keep the current network time as is
+         */
+        void setMaster(bool master);
+
+        inline bool isMaster() const { return _master; }
+
+        inline bool synced() const { return _synced; }
+
+        inline int32_t driftPpm() const { return _clock.driftPpm; }
+
+        /**
+         * @brief Remember when a timed zone started, for the next beacon
+         */
+        void setEpoch(uint8_t port, uint8_t zone, uint32_t startMs);
+
+        void clearEpoch(uint8_t port, uint8_t zone);
+
+        /**
+         * @brief Fill in a beacon stamped with the current network time
+         *
+         * @return bytes written, at most Radio::MaxDataLen
+         */
+        uint8_t writeBeacon(uint8_t *buf);
+
+        /**
+         * @brief Fill in a beacon for any clock, such as the simulator's
+         * stand-in master
+         */
+        static uint8_t writeBeacon(uint8_t *buf, uint64_t masterUs,
+            const ZoneEpoch *epochs, uint8_t count);
+
+        static inline bool isBeacon(const uint8_t *data, uint8_t len)
+        {
+            return len >= 10 && data[0] == Radio::BeaconMagic;
+        }
+
+        /**
+         * @brief Only for messages isBeacon() accepts
+         *
+         * @return the number of epochs read, leaving out any the message was too short for
+         */
+        static uint8_t readBeacon(const uint8_t *data, uint8_t len, uint64_t *masterUs,
+            ZoneEpoch *epochs);
+
+        /**
+         * @brief Time a message of len bytes spends on the air, including the
+         * preamble, sync word, header and CRC the RFM69 adds
+         */
+        static inline uint32_t airtimeUs(uint8_t len)
+        {
+            return (11u + len) * 8u * 1000000u / Radio::BitRate;
+        }
+
+    private:
+        // Network time is anchorNetworkUs at anchorLocalUs, running driftPpm
+        // faster than the local clock from there
+        struct ClockMapping
+        {
+            uint64_t anchorLocalUs;
+            uint64_t anchorNetworkUs;
+            int32_t driftPpm;
+        };
+
+        // correct()'s own copy, which it publishes to _published for readers
+        ClockMapping _clock = {};
+        Seqlock<ClockMapping> _published;
+        // Where drift is measured from, reset whenever the clock jumps
+        uint64_t _refLocalUs = 0;
+        uint64_t _refNetworkUs = 0;
+        bool _synced = false;
+        bool _master = false;
+
+        ZoneEpoch _epochs[Radio::MaxBeaconEpochs];
+        uint8_t _epochCount = 0;
+
+        // setEpoch() runs on either core while core0 beacons
+        mutex_t _mtx;
+};
+
+extern Timebase timebase;
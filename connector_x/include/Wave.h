@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Constants.h"
+
+/**
+ * @brief Integer wave generators for patterns, since the M0+ has no FPU.
+ * A phase is a uint16_t where 65536 is one full cycle, so phases wrap for free.
+ * Outputs are Q15, from -32767 to 32767.
+ */
+namespace Wave
+{
+    struct Settings
+    {
+        // LEDs per cycle, only used by waves that move along the strip
+        uint16_t wavelength;
+        // Phase advanced per state, in 1/256ths of a cycle
+        uint8_t speed;
+    };
+
+    extern const int16_t sineTable[256];
+
+    extern Settings sineRoll;
+    extern Settings breathing;
+
+    inline int16_t sine(uint16_t phase)
+    {
+        uint8_t index = phase >> 8;
+        int32_t a = sineTable[index];
+        int32_t b = sineTable[(uint8_t)(index + 1)];
+
+        // Linearly interpolate with the low byte of the phase
+        return a + (((b - a) * (phase & 0xff)) >> 8);
+    }
+
+    inline int16_t triangle(uint16_t phase)
+    {
+        // Rises over the first half of the cycle, falls over the second
+        int32_t ramp = phase < 0x8000 ? phase : 0xffff - phase;
+        return (ramp * 2) - 32767;
+    }
+
+    inline int16_t sawtooth(uint16_t phase)
+    {
+        return (int32_t)phase - 32768;
+    }
+
+    /**
+     * @brief Map a Q15 sample to 0-255 for use as a brightness
+     */
+    inline uint8_t toBrightness(int16_t sample)
+    {
+        return ((int32_t)sample + 32768) >> 8;
+    }
+
+    inline uint16_t stepForWavelength(uint16_t wavelength)
+    {
+        return wavelength == 0 ? 0 : 65536u / wavelength;
+    }
+
+    /**
+     * @brief Phase reached after some number of states. Any integer speed
+     * lands back on 0 after waveStates states, so looping is seamless.
+     */
+    inline uint16_t phaseForState(uint16_t state, const Settings &settings)
+    {
+        return (uint16_t)(state * settings.speed << 8);
+    }
+
+    /**
+     * @brief Walks a phase forward by a fixed step, one sample at a time
+     */
+    struct PhaseAccumulator
+    {
+        uint16_t phase;
+        uint16_t step;
+
+        inline uint16_t next()
+        {
+            uint16_t current = phase;
+            phase += step;
+            return current;
+        }
+    };
+} // namespace Wave
@@ -3,7 +3,6 @@
 #include <Arduino.h>
 
 #include <string>
-#include "Commands.h"
 
 struct ZoneDefinition {
     uint16_t offset;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <FastLED.h>
+
+/**
+ * @brief A window into a port's pixel buffer that patterns render into directly.
+ * Index 0 is always the first logical pixel of the zone, so reversed zones are
+ * handled by walking the underlying buffer backwards rather than copying.
+ */
+class ZoneView {
+    public:
+        ZoneView(CRGB *base, uint16_t count)
+            : _base(base), _count(count), _stride(1)
+        {
+        }
+
+        ZoneView(CRGB *leds, uint16_t offset, uint16_t count, bool reversed)
+            : _base(reversed ? &leds[offset + count - 1] : &leds[offset]),
+              _count(count), _stride(reversed ? -1 : 1)
+        {
+        }
+
+        inline CRGB& operator[](uint16_t index) const
+        {
+            return _base[(int32_t)index * _stride];
+        }
+
+        inline uint16_t count() const { return _count; }
+
+        inline bool reversed() const { return _stride < 0; }
+
+        /**
+         * @brief Pointer to the lowest address in the zone, regardless of direction
+         */
+        inline CRGB *data() const
+        {
+            return reversed() ? _base - (_count - 1) : _base;
+        }
+
+        inline void clear() const
+        {
+            memset((void *)data(), 0, sizeof(CRGB) * _count);
+        }
+
+    private:
+        CRGB *_base;
+        uint16_t _count;
+        int8_t _stride;
+};
+
+/**
+ * @brief A ZoneView whose direction is fixed at compile time. Patterns built
+ * for one of these index the buffer directly instead of multiplying by a
+ * stride on every pixel.
+ */
+template <int8_t Stride>
+class FixedZoneView {
+    static_assert(Stride == 1 || Stride == -1, "Zones run forwards or backwards");
+
+    public:
+        explicit FixedZoneView(const ZoneView &view)
+            : _base(&view[0]), _count(view.count())
+        {
+        }
+
+        inline CRGB& operator[](uint16_t index) const
+        {
+            return Stride > 0 ? _base[index] : *(_base - index);
+        }
+
+        inline uint16_t count() const { return _count; }
+
+        static constexpr bool reversed() { return Stride < 0; }
+
+        inline CRGB *data() const
+        {
+            return reversed() ? _base - (_count - 1) : _base;
+        }
+
+        inline void clear() const
+        {
+            memset((void *)data(), 0, sizeof(CRGB) * _count);
+        }
+
+    private:
+        CRGB *_base;
+        uint16_t _count;
+};
+
+using ForwardZoneView = FixedZoneView<1>;
+using ReversedZoneView = FixedZoneView<-1>;
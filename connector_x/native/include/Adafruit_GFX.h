@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host stand-in for the few Adafruit_GFX drawing calls the patterns use
+
+class Adafruit_GFX {
+    public:
+        Adafruit_GFX(int16_t width, int16_t height) : _width(width), _height(height) {}
+        virtual ~Adafruit_GFX() = default;
+
+        virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+        void fillScreen(uint16_t color)
+        {
+            for (int16_t y = 0; y < _height; y++)
+            {
+                for (int16_t x = 0; x < _width; x++)
+                {
+                    drawPixel(x, y, color);
+                }
+            }
+        }
+
+        void drawFastVLine(int16_t x, int16_t y, int16_t height, uint16_t color)
+        {
+            for (int16_t i = 0; i < height; i++)
+            {
+                drawPixel(x, y + i, color);
+            }
+        }
+
+        void drawRGBBitmap(int16_t x, int16_t y, const uint16_t *bitmap,
+            int16_t width, int16_t height)
+        {
+            for (int16_t row = 0; row < height; row++)
+            {
+                for (int16_t col = 0; col < width; col++)
+                {
+                    drawPixel(x + col, y + row, bitmap[row * width + col]);
+                }
+            }
+        }
+
+        inline int16_t width() const { return _width; }
+
+        inline int16_t height() const { return _height; }
+
+    protected:
+        int16_t _width;
+        int16_t _height;
+};
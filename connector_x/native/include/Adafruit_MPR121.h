@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Nothing is ever touched in the simulator
+
+class Adafruit_MPR121 {
+    public:
+        bool begin(uint8_t address = 0x5A, TwoWire *wire = &Wire) { return true; }
+        uint16_t touched() { return 0; }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core the firmware uses.
+// Time only moves when the simulator advances it, so runs are repeatable.
+
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include <pico/mutex.h>
+#include <pico/stdlib.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define A0 26
+#define A1 27
+#define A2 28
+#define A3 29
+
+#define F(string) string
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+inline void digitalWriteFast(uint8_t pin, uint8_t value)
+{
+    digitalWrite(pin, value);
+}
+
+class String : public std::string {
+    public:
+        String() = default;
+        String(const char *str) : std::string(str) {}
+        String(const std::string &str) : std::string(str) {}
+        String(int value) : std::string(std::to_string(value)) {}
+        String(unsigned int value) : std::string(std::to_string(value)) {}
+        String(long value) : std::string(std::to_string(value)) {}
+        String(unsigned long value) : std::string(std::to_string(value)) {}
+
+        inline String operator+(const String &other) const
+        {
+            return String((const std::string &)*this + other);
+        }
+};
+
+/**
+ * @brief Serial ports print to stderr so stdout is left for the simulator's
+ * own output. Nothing is ever received.
+ */
+class Stream {
+    public:
+        explicit Stream(FILE *out = stderr) : _out(out) {}
+        virtual ~Stream() = default;
+
+        void begin(unsigned long baud) {}
+        void setTX(uint8_t pin) {}
+        void setRX(uint8_t pin) {}
+        explicit operator bool() const { return true; }
+
+        int printf(const char *format, ...);
+
+        size_t print(const char *str) { return fputs(str, _out); }
+        size_t print(const std::string &str) { return print(str.c_str()); }
+        size_t print(long value) { return fprintf(_out, "%ld", value); }
+        size_t print(double value) { return fprintf(_out, "%.2f", value); }
+
+        size_t println() { return print("\n"); }
+
+        template <typename T>
+        size_t println(const T &value)
+        {
+            return print(value) + println();
+        }
+
+        virtual int available() { return 0; }
+        virtual int read() { return -1; }
+        virtual size_t write(uint8_t value) { return 1; }
+
+        virtual size_t write(const uint8_t *buf, size_t len)
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                write(buf[i]);
+            }
+
+            return len;
+        }
+
+        size_t readBytes(uint8_t *buf, size_t len)
+        {
+            size_t count = 0;
+            int value;
+
+            while (count < len && (value = read()) >= 0)
+            {
+                buf[count++] = value;
+            }
+
+            return count;
+        }
+
+        size_t readBytes(char *buf, size_t len)
+        {
+            return readBytes((uint8_t *)buf, len);
+        }
+
+        long parseInt() { return 0; }
+
+    private:
+        FILE *_out;
+};
+
+extern Stream Serial;
+extern Stream Serial1;
+
+/**
+ * @brief Both cores run on the simulator's one thread, so there's nothing
+ * to pause or restart
+ */
+class RP2040 {
+    public:
+        void idleOtherCore() {}
+        void resumeOtherCore() {}
+        void restartCore1() {}
+
+        uint32_t getCycleCount();
+        uint64_t getCycleCount64();
+};
+
+extern RP2040 rp2040;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host stand-in for FastLED's pixel type. Output goes through LedOutput, so
+// no controllers are needed.
+
+struct CRGB {
+    union {
+        struct {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        struct {
+            uint8_t red;
+            uint8_t green;
+            uint8_t blue;
+        };
+        uint8_t raw[3];
+    };
+
+    enum HTMLColorCode {
+        Black = 0x000000,
+        White = 0xFFFFFF,
+    };
+
+    CRGB() = default;
+
+    constexpr CRGB(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue) {}
+
+    constexpr CRGB(uint32_t colorCode)
+        : r((colorCode >> 16) & 0xff), g((colorCode >> 8) & 0xff), b(colorCode & 0xff) {}
+
+    constexpr CRGB(HTMLColorCode colorCode) : CRGB((uint32_t)colorCode) {}
+
+    inline CRGB &operator=(uint32_t colorCode)
+    {
+        r = (colorCode >> 16) & 0xff;
+        g = (colorCode >> 8) & 0xff;
+        b = colorCode & 0xff;
+        return *this;
+    }
+
+    inline uint8_t &operator[](uint8_t index) { return raw[index]; }
+
+    inline const uint8_t &operator[](uint8_t index) const { return raw[index]; }
+
+    inline explicit operator bool() const { return r || g || b; }
+
+    inline operator uint32_t() const
+    {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+};
+
+inline bool operator==(const CRGB &lhs, const CRGB &rhs)
+{
+    return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b;
+}
+
+inline bool operator!=(const CRGB &lhs, const CRGB &rhs)
+{
+    return !(lhs == rhs);
+}
+
+// Same octal packing as FastLED: one digit per wire byte naming its channel
+enum EOrder {
+    RGB = 0012,
+    RBG = 0021,
+    GRB = 0102,
+    GBR = 0120,
+    BRG = 0201,
+    BGR = 0210,
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <FastLED.h>
+
+// Host stand-in for a single FastLED_NeoMatrix. Wiring order follows the
+// real library; colors expand linearly from 565 where the real one applies
+// a gamma table.
+
+#define NEO_MATRIX_TOP 0x00
+#define NEO_MATRIX_BOTTOM 0x01
+#define NEO_MATRIX_LEFT 0x00
+#define NEO_MATRIX_RIGHT 0x02
+#define NEO_MATRIX_CORNER 0x03
+#define NEO_MATRIX_ROWS 0x00
+#define NEO_MATRIX_COLUMNS 0x04
+#define NEO_MATRIX_AXIS 0x04
+#define NEO_MATRIX_PROGRESSIVE 0x00
+#define NEO_MATRIX_ZIGZAG 0x08
+#define NEO_MATRIX_SEQUENCE 0x08
+
+class FastLED_NeoMatrix : public Adafruit_GFX {
+    public:
+        FastLED_NeoMatrix(CRGB *leds, uint8_t width, uint8_t height, uint8_t flags)
+            : Adafruit_GFX(width, height), _leds(leds), _flags(flags) {}
+
+        void drawPixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            if (x < 0 || y < 0 || x >= _width || y >= _height)
+            {
+                return;
+            }
+
+            _leds[XY(x, y)] = CRGB(((color >> 11) & 0x1f) << 3,
+                ((color >> 5) & 0x3f) << 2, (color & 0x1f) << 3);
+        }
+
+        uint16_t XY(int16_t x, int16_t y) const
+        {
+            uint8_t corner = _flags & NEO_MATRIX_CORNER;
+            uint16_t major, minor, majorScale;
+
+            if (_flags & NEO_MATRIX_AXIS)
+            {
+                major = x;
+                minor = y;
+                majorScale = _height;
+
+                if (corner & NEO_MATRIX_RIGHT) major = _width - 1 - major;
+                if (corner & NEO_MATRIX_BOTTOM) minor = _height - 1 - minor;
+            }
+            else
+            {
+                major = y;
+                minor = x;
+                majorScale = _width;
+
+                if (corner & NEO_MATRIX_BOTTOM) major = _height - 1 - major;
+                if (corner & NEO_MATRIX_RIGHT) minor = _width - 1 - minor;
+            }
+
+            if ((_flags & NEO_MATRIX_SEQUENCE) == NEO_MATRIX_ZIGZAG && (major & 1))
+            {
+                minor = majorScale - 1 - minor;
+            }
+
+            return major * majorScale + minor;
+        }
+
+        static uint16_t Color24to16(uint32_t color)
+        {
+            return ((color >> 8) & 0xf800) | ((color >> 5) & 0x07e0) |
+                ((color >> 3) & 0x001f);
+        }
+
+    private:
+        CRGB *_leds;
+        uint8_t _flags;
+};
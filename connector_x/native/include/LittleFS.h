@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <memory>
+
+// Host stand-in for LittleFS, read-only, rooted at a directory on the host
+// (the project's data/ folder by default)
+
+class File : public Stream {
+    public:
+        File() = default;
+        explicit File(FILE *handle);
+
+        explicit operator bool() const { return (bool)_handle; }
+
+        int available() override;
+        int read() override;
+        size_t size();
+        size_t position();
+        bool seek(uint32_t position);
+        void close();
+
+    private:
+        std::shared_ptr<FILE> _handle;
+};
+
+class LittleFSConfig {
+    public:
+        void setAutoFormat(bool autoFormat) {}
+};
+
+class FS {
+    public:
+        bool begin() { return true; }
+        void setConfig(const LittleFSConfig &config) {}
+
+        File open(const char *path, const char *mode);
+        File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+        bool exists(const char *path);
+
+        /**
+         * @brief Host directory that "/" maps to
+         */
+        void setRoot(const std::string &root) { _root = root; }
+
+    private:
+        std::string _root = "data";
+};
+
+extern FS LittleFS;
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Hooks the simulator uses to drive the host stand-ins
+ */
+namespace Native
+{
+    uint64_t nowUs();
+
+    void advanceUs(uint64_t us);
+
+    /**
+     * @brief Which core get_core_num() reports on the calling thread
+     */
+    void setCoreNum(uint8_t core);
+
+    /**
+     * @brief Gets every buffer sent to a PIO state machine by DMA, along with
+     * the pin that state machine drives
+     */
+    typedef void (*FrameSink)(uint8_t pin, const uint32_t *words, uint16_t count);
+
+    void setFrameSink(FrameSink sink);
+
+    struct RadioLink {
+        // On top of the time the message takes on the air, which starts
+        // once every message sent before it is off the air
+        uint32_t latencyUs;
+        // Up to this much more, picked at random for every message
+        uint32_t jitterUs;
+        uint8_t lossPercent;
+    };
+
+    /**
+     * @brief How the simulated radios' shared link delays and drops messages.
+     * The random choices are seeded the same on every run.
+     */
+    void setRadioLink(const RadioLink &link);
+
+    // Messages the link has thrown away
+    uint32_t radioLost();
+
+    struct RadioAirtime {
+        uint32_t frames;
+        // The library's send() only returns once the frame is off the air,
+        // so this is how long the sender's core was held up
+        uint64_t totalUs;
+        uint32_t longestUs;
+    };
+
+    /**
+     * @brief Everything the radio at this address has sent, acks included
+     */
+    RadioAirtime radioAirtime(uint16_t address);
+} // namespace Native
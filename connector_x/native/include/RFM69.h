@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// Every radio the simulator makes shares one loopback link, set up with
+// Native::setRadioLink, so whatever one sends the others receive
+
+#define RF69_MAX_DATA_LEN 61
+#define RF69_915MHZ 91
+#define RF69_BROADCAST_ADDR 255
+
+class RFM69 {
+    public:
+        RFM69(uint8_t slaveSelectPin, uint8_t interruptPin, bool isRFM69HW, SPIClass *spi);
+
+        ~RFM69();
+
+        bool initialize(uint8_t frequency, uint16_t nodeId, uint8_t networkId);
+        void setFrequency(uint32_t frequency);
+        void setHighPower(bool highPower = true);
+        void setPowerLevel(uint8_t level);
+        bool receiveDone();
+        // True while nothing is on the air
+        bool canSend();
+        bool ACKRequested();
+        void sendACK(const void *buffer = nullptr, uint8_t bufferSize = 0);
+        void send(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+            bool requestACK = false);
+        bool sendWithRetry(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+            uint8_t retries = 2, uint8_t retryWaitTime = 40);
+
+        uint8_t DATA[RF69_MAX_DATA_LEN + 1];
+        uint16_t SENDERID;
+        uint16_t TARGETID;
+        uint8_t DATALEN;
+        int16_t RSSI;
+        uint8_t ACK_REQUESTED;
+        uint8_t ACK_RECEIVED;
+
+    private:
+        void transmit(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+            bool requestACK, bool isAck);
+
+        uint16_t _address = 0;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <RFM69.h>
+
+class RFM69_ATC : public RFM69 {
+    public:
+        using RFM69::RFM69;
+
+        void enableAutoPower(int16_t targetRSSI = -90);
+};
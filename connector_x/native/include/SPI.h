@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+class SPIClass {
+    public:
+        void setTX(uint8_t pin) {}
+        void setRX(uint8_t pin) {}
+        void setSCK(uint8_t pin) {}
+        void setCS(uint8_t pin) {}
+        void begin() {}
+};
+
+extern SPIClass SPI;
+extern SPIClass SPI1;
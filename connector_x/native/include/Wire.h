@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+/**
+ * @brief Host stand-in for an I2C peripheral. The simulator plays the
+ * controller through write() and read(), which call the registered handlers
+ * the same way the bus interrupt would.
+ */
+class TwoWire : public Stream {
+    public:
+        void setSDA(uint8_t pin) {}
+        void setSCL(uint8_t pin) {}
+        void begin() {}
+        void begin(uint8_t address) {}
+
+        void onReceive(void (*handler)(int)) { _onReceive = handler; }
+        void onRequest(void (*handler)(void)) { _onRequest = handler; }
+
+        int available() override { return _received.size() - _readIndex; }
+
+        int read() override
+        {
+            return _readIndex < _received.size() ? _received[_readIndex++] : -1;
+        }
+
+        size_t write(uint8_t value) override
+        {
+            _response.push_back(value);
+            return 1;
+        }
+
+        using Stream::write;
+
+        /**
+         * @brief Deliver a controller write to the receive handler
+         */
+        void simulateWrite(const uint8_t *data, size_t len)
+        {
+            _received.assign(data, data + len);
+            _readIndex = 0;
+
+            if (_onReceive)
+            {
+                _onReceive(len);
+            }
+        }
+
+        /**
+         * @brief Run the request handler and collect what it wrote back
+         */
+        std::vector<uint8_t> simulateRead()
+        {
+            _response.clear();
+
+            if (_onRequest)
+            {
+                _onRequest();
+            }
+
+            return _response;
+        }
+
+    private:
+        void (*_onReceive)(int) = nullptr;
+        void (*_onRequest)(void) = nullptr;
+
+        std::vector<uint8_t> _received;
+        size_t _readIndex = 0;
+        std::vector<uint8_t> _response;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <pico/stdlib.h>
+
+// Host stand-in for the ADC API. Samples are never produced.
+
+struct adc_hw_t {
+    volatile uint32_t fifo;
+};
+
+extern adc_hw_t *adc_hw;
+
+inline void adc_init() {}
+inline void adc_gpio_init(uint pin) {}
+inline void adc_select_input(uint input) {}
+inline void adc_fifo_setup(bool enable, bool dreqEnable, uint16_t dreqThreshold,
+    bool errorInFifo, bool byteShift) {}
+inline void adc_set_clkdiv(float div) {}
+inline void adc_run(bool run) {}
+inline void adc_fifo_drain() {}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <pico/stdlib.h>
+
+// Host stand-in for the DMA API. A transfer completes the moment it starts;
+// transfers into a PIO TX FIFO are handed to the simulator as LED frames.
+
+struct dma_channel_config {
+    uint dreq;
+};
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+enum {
+    DREQ_ADC = 36,
+};
+
+// Raw completion flags, which stay clear since nothing is ever sampled
+struct dma_hw_t {
+    volatile uint32_t intr;
+};
+
+extern dma_hw_t *dma_hw;
+
+uint dma_claim_unused_channel(bool required);
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+    volatile void *writeAddr, const volatile void *readAddr, uint count, bool trigger);
+
+inline dma_channel_config dma_channel_get_default_config(uint channel) { return {}; }
+inline void channel_config_set_transfer_data_size(dma_channel_config *config, dma_channel_transfer_size size) {}
+inline void channel_config_set_read_increment(dma_channel_config *config, bool increment) {}
+inline void channel_config_set_write_increment(dma_channel_config *config, bool increment) {}
+inline void channel_config_set_dreq(dma_channel_config *config, uint dreq) { config->dreq = dreq; }
+inline void channel_config_set_ring(dma_channel_config *config, bool write, uint sizeBits) {}
+inline void channel_config_set_chain_to(dma_channel_config *config, uint channel) {}
+inline void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger) {}
+inline void dma_channel_start(uint channel) {}
+inline void dma_channel_abort(uint channel) {}
+inline bool dma_channel_is_busy(uint channel) { return false; }
+inline void dma_channel_wait_for_finish_blocking(uint channel) {}
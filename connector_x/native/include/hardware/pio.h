@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pico/stdlib.h>
+
+// Host stand-in for the PIO API. State machines do nothing; the simulator
+// only remembers which pin each one drives so DMA transfers into its FIFO
+// can be recorded as frames for that pin.
+
+struct pio_hw_t {
+    volatile uint32_t txf[4];
+};
+
+typedef pio_hw_t *PIO;
+
+extern PIO pio0;
+extern PIO pio1;
+
+struct pio_program_t {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+};
+
+struct pio_sm_config {
+    uint32_t unused;
+};
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool isOut);
+uint pio_get_dreq(PIO pio, uint sm, bool isTx);
+
+inline pio_sm_config pio_get_default_sm_config() { return {}; }
+inline void sm_config_set_wrap(pio_sm_config *config, uint target, uint wrap) {}
+inline void sm_config_set_sideset(pio_sm_config *config, uint bits, bool optional, bool pindirs) {}
+inline void sm_config_set_sideset_pins(pio_sm_config *config, uint pin) {}
+inline void sm_config_set_out_shift(pio_sm_config *config, bool right, bool autopull, uint threshold) {}
+inline void sm_config_set_fifo_join(pio_sm_config *config, pio_fifo_join join) {}
+inline void sm_config_set_clkdiv(pio_sm_config *config, float div) {}
+inline void pio_gpio_init(PIO pio, uint pin) {}
+inline void pio_sm_init(PIO pio, uint sm, uint offset, const pio_sm_config *config) {}
+inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {}
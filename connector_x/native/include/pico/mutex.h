@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Both cores usually run on one thread in the simulator, but with -j core0
+// has a thread of its own, so this has to really exclude
+
+struct mutex_t {
+    std::atomic<bool> owned{false};
+};
+
+inline void mutex_init(mutex_t *mtx) { mtx->owned.store(false, std::memory_order_relaxed); }
+
+inline bool mutex_try_enter(mutex_t *mtx, uint32_t *owner)
+{
+    return !mtx->owned.exchange(true, std::memory_order_acquire);
+}
+
+inline void mutex_enter_blocking(mutex_t *mtx)
+{
+    while (!mutex_try_enter(mtx, nullptr))
+    {
+        std::this_thread::yield();
+    }
+}
+
+// Simulated time doesn't pass while a thread waits, so this waits as long as it takes
+inline bool mutex_enter_timeout_us(mutex_t *mtx, uint32_t timeoutUs)
+{
+    mutex_enter_blocking(mtx);
+    return true;
+}
+
+inline void mutex_exit(mutex_t *mtx) { mtx->owned.store(false, std::memory_order_release); }
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+typedef unsigned int uint;
+
+#define __not_in_flash_func(name) name
+#define __time_critical_func(name) name
+
+uint64_t time_us_64();
+
+// 0 on the thread the simulator gives core0 with -j, otherwise 1
+uint get_core_num();
+
+// Busy waits let the other core's thread run, in case they share a CPU
+inline void tight_loop_contents() { std::this_thread::yield(); }
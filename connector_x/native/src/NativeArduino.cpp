@@ -0,0 +1,172 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#include <pico/stdlib.h>
+
+#include "Native.h"
+
+#include <atomic>
+
+Stream Serial;
+Stream Serial1;
+TwoWire Wire;
+TwoWire Wire1;
+SPIClass SPI;
+SPIClass SPI1;
+RP2040 rp2040;
+FS LittleFS;
+
+namespace
+{
+    // Read from both cores when the simulator runs them on separate threads
+    std::atomic<uint64_t> clockUs{0};
+    uint8_t pinLevels[32] = {};
+    thread_local uint8_t coreNum = 1;
+}
+
+uint64_t Native::nowUs()
+{
+    return clockUs;
+}
+
+void Native::advanceUs(uint64_t us)
+{
+    clockUs.fetch_add(us);
+}
+
+unsigned long millis()
+{
+    return clockUs / 1000;
+}
+
+unsigned long micros()
+{
+    return clockUs;
+}
+
+uint64_t time_us_64()
+{
+    return clockUs;
+}
+
+void Native::setCoreNum(uint8_t core)
+{
+    coreNum = core;
+}
+
+uint get_core_num()
+{
+    return coreNum;
+}
+
+void delay(unsigned long ms)
+{
+    Native::advanceUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    Native::advanceUs(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < sizeof(pinLevels))
+    {
+        pinLevels[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < sizeof(pinLevels) ? pinLevels[pin] : LOW;
+}
+
+int Stream::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(_out, format, args);
+    va_end(args);
+
+    return written;
+}
+
+uint32_t RP2040::getCycleCount()
+{
+    return getCycleCount64();
+}
+
+uint64_t RP2040::getCycleCount64()
+{
+    // At the firmware's 133MHz system clock
+    return clockUs * 133;
+}
+
+File::File(FILE *handle)
+    : _handle(handle, fclose)
+{
+}
+
+int File::available()
+{
+    return _handle ? size() - position() : 0;
+}
+
+int File::read()
+{
+    return _handle ? fgetc(_handle.get()) : -1;
+}
+
+size_t File::size()
+{
+    if (!_handle)
+    {
+        return 0;
+    }
+
+    long current = ftell(_handle.get());
+    fseek(_handle.get(), 0, SEEK_END);
+    long end = ftell(_handle.get());
+    fseek(_handle.get(), current, SEEK_SET);
+
+    return end;
+}
+
+size_t File::position()
+{
+    return _handle ? ftell(_handle.get()) : 0;
+}
+
+bool File::seek(uint32_t position)
+{
+    return _handle && fseek(_handle.get(), position, SEEK_SET) == 0;
+}
+
+void File::close()
+{
+    _handle.reset();
+}
+
+File FS::open(const char *path, const char *mode)
+{
+    // Read-only: the firmware never writes to flash at runtime
+    if (strcmp(mode, "r") != 0)
+    {
+        return File();
+    }
+
+    FILE *handle = fopen((_root + path).c_str(), "rb");
+    return handle ? File(handle) : File();
+}
+
+bool FS::exists(const char *path)
+{
+    return (bool)open(path, "r");
+}
@@ -0,0 +1,87 @@
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+#include <hardware/pio.h>
+
+#include "Native.h"
+
+namespace
+{
+    constexpr uint8_t SmPerPio = 4;
+    constexpr uint8_t NoPin = 0xff;
+
+    pio_hw_t pioBlocks[2];
+    uint8_t smClaimed[2] = {};
+    uint8_t smPins[2][SmPerPio] = {
+        {NoPin, NoPin, NoPin, NoPin},
+        {NoPin, NoPin, NoPin, NoPin},
+    };
+    uint dmaClaimed = 0;
+    adc_hw_t adcBlock;
+    dma_hw_t dmaBlock;
+
+    Native::FrameSink frameSink = nullptr;
+
+    inline uint8_t pioIndex(PIO pio)
+    {
+        return pio == &pioBlocks[0] ? 0 : 1;
+    }
+}
+
+PIO pio0 = &pioBlocks[0];
+PIO pio1 = &pioBlocks[1];
+adc_hw_t *adc_hw = &adcBlock;
+dma_hw_t *dma_hw = &dmaBlock;
+
+void Native::setFrameSink(FrameSink sink)
+{
+    frameSink = sink;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+    return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    uint8_t &claimed = smClaimed[pioIndex(pio)];
+    return claimed < SmPerPio ? claimed++ : -1;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool isOut)
+{
+    smPins[pioIndex(pio)][sm] = pin;
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool isTx)
+{
+    // Matches the RP2040's DREQ_PIO0_TX0 numbering
+    return pioIndex(pio) * 8 + (isTx ? 0 : 4) + sm;
+}
+
+uint dma_claim_unused_channel(bool required)
+{
+    return dmaClaimed++;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+    volatile void *writeAddr, const volatile void *readAddr, uint count, bool trigger)
+{
+    if (!trigger || !frameSink)
+    {
+        return;
+    }
+
+    // Only transfers into a state machine's TX FIFO are LED frames
+    for (uint8_t pio = 0; pio < 2; pio++)
+    {
+        for (uint8_t sm = 0; sm < SmPerPio; sm++)
+        {
+            if (writeAddr == &pioBlocks[pio].txf[sm] && smPins[pio][sm] != NoPin)
+            {
+                frameSink(smPins[pio][sm], (const uint32_t *)readAddr, count);
+                return;
+            }
+        }
+    }
+}
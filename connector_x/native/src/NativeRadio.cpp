@@ -0,0 +1,295 @@
+#include <Hash.h>
+#include <RFM69.h>
+#include <RFM69_ATC.h>
+
+#include "Native.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct InFlight {
+        uint64_t arrivesUs;
+        RFM69 *to;
+        uint16_t senderId;
+        uint16_t targetId;
+        bool ackRequested;
+        bool isAck;
+        uint8_t len;
+        uint8_t data[RF69_MAX_DATA_LEN];
+    };
+
+    Native::RadioLink link = {};
+    uint32_t lost = 0;
+    // One radio sends at a time, so anything sent before this waits its turn
+    uint64_t airFreeUs = 0;
+    uint32_t randomState = 1;
+    std::vector<RFM69 *> radios;
+    std::vector<InFlight> inFlight;
+    std::map<uint16_t, Native::RadioAirtime> airtimes;
+    // With -j the board's radio runs on core0's thread while the simulator's
+    // own radios run on the main one
+    std::mutex linkMtx;
+
+    // Fixed seed, so runs repeat
+    uint32_t nextRandom()
+    {
+        randomState = randomState * 1103515245u + 12345u;
+        return randomState >> 8;
+    }
+
+    // At the RFM69 library's default bit rate, with its preamble, sync word,
+    // header and CRC
+    uint32_t airtimeUs(uint8_t len)
+    {
+        return (11u + len) * 8u * 1000000u / 55555u;
+    }
+
+    inline uint32_t rotl(uint32_t value, uint8_t bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+}
+
+void Native::setRadioLink(const RadioLink &radioLink)
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    link = radioLink;
+}
+
+uint32_t Native::radioLost()
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    return lost;
+}
+
+Native::RadioAirtime Native::radioAirtime(uint16_t address)
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    return airtimes[address];
+}
+
+RFM69::RFM69(uint8_t slaveSelectPin, uint8_t interruptPin, bool isRFM69HW, SPIClass *spi)
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    radios.push_back(this);
+}
+
+RFM69::~RFM69()
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    radios.erase(std::remove(radios.begin(), radios.end(), this), radios.end());
+    inFlight.erase(std::remove_if(inFlight.begin(), inFlight.end(),
+        [this](const InFlight &message) { return message.to == this; }), inFlight.end());
+}
+
+bool RFM69::initialize(uint8_t frequency, uint16_t nodeId, uint8_t networkId)
+{
+    _address = nodeId;
+    return true;
+}
+
+void RFM69::setFrequency(uint32_t frequency)
+{
+}
+
+void RFM69::setHighPower(bool highPower)
+{
+}
+
+void RFM69::setPowerLevel(uint8_t level)
+{
+}
+
+void RFM69_ATC::enableAutoPower(int16_t targetRSSI)
+{
+}
+
+bool RFM69::receiveDone()
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    uint64_t now = Native::nowUs();
+
+    // Oldest arrival first
+    auto next = inFlight.end();
+    for (auto it = inFlight.begin(); it != inFlight.end(); ++it)
+    {
+        if (it->to == this && it->arrivesUs <= now &&
+            (next == inFlight.end() || it->arrivesUs < next->arrivesUs))
+        {
+            next = it;
+        }
+    }
+
+    if (next == inFlight.end())
+    {
+        return false;
+    }
+
+    SENDERID = next->senderId;
+    TARGETID = next->targetId;
+    ACK_REQUESTED = next->ackRequested;
+    ACK_RECEIVED = next->isAck;
+    DATALEN = next->len;
+    memcpy(DATA, next->data, next->len);
+    DATA[DATALEN] = 0;
+    RSSI = -40;
+
+    inFlight.erase(next);
+    return true;
+}
+
+bool RFM69::canSend()
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    return airFreeUs <= Native::nowUs();
+}
+
+bool RFM69::ACKRequested()
+{
+    return ACK_REQUESTED && TARGETID != RF69_BROADCAST_ADDR;
+}
+
+void RFM69::sendACK(const void *buffer, uint8_t bufferSize)
+{
+    transmit(SENDERID, buffer, bufferSize, false, true);
+}
+
+void RFM69::send(uint16_t toAddress, const void *buffer, uint8_t bufferSize, bool requestACK)
+{
+    transmit(toAddress, buffer, bufferSize, requestACK, false);
+}
+
+void RFM69::transmit(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+    bool requestACK, bool isAck)
+{
+    std::lock_guard<std::mutex> lock(linkMtx);
+    bufferSize = std::min<uint8_t>(bufferSize, RF69_MAX_DATA_LEN);
+
+    uint64_t sentUs = std::max(Native::nowUs(), airFreeUs) + airtimeUs(bufferSize);
+    airFreeUs = sentUs;
+
+    Native::RadioAirtime &airtime = airtimes[_address];
+    uint32_t heldUs = sentUs - Native::nowUs();
+    airtime.frames++;
+    airtime.totalUs += heldUs;
+    airtime.longestUs = std::max(airtime.longestUs, heldUs);
+
+    for (RFM69 *radio : radios)
+    {
+        if (radio == this ||
+            (toAddress != RF69_BROADCAST_ADDR && toAddress != radio->_address))
+        {
+            continue;
+        }
+
+        if (nextRandom() % 100 < link.lossPercent)
+        {
+            lost++;
+            continue;
+        }
+
+        InFlight message;
+        message.arrivesUs = sentUs + link.latencyUs +
+            (link.jitterUs > 0 ? nextRandom() % (link.jitterUs + 1) : 0);
+        message.to = radio;
+        message.senderId = _address;
+        message.targetId = toAddress;
+        message.ackRequested = requestACK;
+        message.isAck = isAck;
+        message.len = bufferSize;
+        if (bufferSize > 0)
+        {
+            memcpy(message.data, buffer, bufferSize);
+        }
+
+        inFlight.push_back(message);
+    }
+}
+
+bool RFM69::sendWithRetry(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+    uint8_t retries, uint8_t retryWaitTime)
+{
+    send(toAddress, buffer, bufferSize, true);
+    return true;
+}
+
+void sha1(const uint8_t *data, uint32_t size, uint8_t hash[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    // Message, a 1 bit, zeros, then the length in bits, padded to 64-byte blocks
+    std::vector<uint8_t> message(data, data + size);
+    message.push_back(0x80);
+    while (message.size() % 64 != 56)
+    {
+        message.push_back(0);
+    }
+    uint64_t bits = (uint64_t)size * 8;
+    for (int8_t shift = 56; shift >= 0; shift -= 8)
+    {
+        message.push_back(bits >> shift);
+    }
+
+    for (size_t block = 0; block < message.size(); block += 64)
+    {
+        uint32_t w[80];
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            const uint8_t *word = &message[block + i * 4];
+            w[i] = (word[0] << 24) | (word[1] << 16) | (word[2] << 8) | word[3];
+        }
+        for (uint8_t i = 16; i < 80; i++)
+        {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (uint8_t i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        hash[i] = h[i / 4] >> (24 - (i % 4) * 8);
+    }
+}
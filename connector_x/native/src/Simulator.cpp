@@ -0,0 +1,652 @@
+// The tests under test/ link against the rest of the build with a main of their own
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RFM69.h>
+#include <Wire.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Configuration.h"
+#include "Constants.h"
+#include "FftBenchmark.h"
+#include "Native.h"
+#include "PacketRadio.h"
+#include "PatternBenchmark.h"
+#include "RadioTransfer.h"
+#include "Timebase.h"
+
+// The firmware's entry points from main.cpp
+void setup();
+void loop();
+void setup1();
+void loop1();
+
+namespace
+{
+    struct ScriptEvent {
+        // Since the end of setup()
+        uint64_t atUs;
+        bool isWrite;
+        std::vector<uint8_t> bytes;
+    };
+
+    uint32_t frameCounts[PinConstants::LED::NumPorts] = {};
+    bool printPixels = false;
+    // Simulated time each frame sent holds its core up for
+    uint32_t stallUs = 0;
+
+    /**
+     * @brief Another board on the radio link, acting as the timebase master
+     * with a clock that starts ahead of this one's and runs at its own rate
+     */
+    struct SyncMaster {
+        static constexpr int64_t OffsetUs = 2500000;
+        // Errors are only counted once the first beacons have had time to land
+        static constexpr uint64_t SettleUs = 2000000;
+
+        RFM69 radio{0, 0, true, nullptr};
+        int32_t driftPpm = 0;
+        uint64_t nextBeaconUs = 0;
+        uint64_t firstBeaconUs = 0;
+        uint32_t beacons = 0;
+        int64_t worstErrorUs = 0;
+        int64_t lastErrorUs = 0;
+
+        SyncMaster()
+        {
+            radio.initialize(Radio::Frequency, 0, Radio::NetworkId);
+        }
+
+        uint64_t clockUs(uint64_t localUs) const
+        {
+            return localUs + OffsetUs + (int64_t)localUs * driftPpm / 1000000;
+        }
+
+        void update()
+        {
+            uint64_t now = Native::nowUs();
+
+            // Only here to send, so whatever the board sends is dropped
+            while (radio.receiveDone())
+            {
+            }
+
+            if (now >= nextBeaconUs)
+            {
+                // Every zone on port 0 started at the master's boot, if timed
+                ZoneEpoch epochs[4];
+                for (uint8_t zone = 0; zone < 4; zone++)
+                {
+                    epochs[zone] = {0, 0, zone};
+                }
+
+                uint8_t beacon[Radio::MaxDataLen];
+                uint8_t len = Timebase::writeBeacon(beacon, clockUs(now), epochs, 4);
+                radio.send(RF69_BROADCAST_ADDR, beacon, len);
+
+                firstBeaconUs = beacons++ == 0 ? now : firstBeaconUs;
+                nextBeaconUs = now + Radio::DefaultBeaconIntervalMs * 1000;
+            }
+
+            if (beacons > 0 && now - firstBeaconUs >= SettleUs)
+            {
+                lastErrorUs = (int64_t)(timebase.toNetworkUs(now) - clockUs(now));
+                worstErrorUs = std::max(worstErrorUs, std::abs(lastErrorUs));
+            }
+        }
+    };
+
+    /**
+     * @brief Another board on the radio link that sends a burst of messages
+     * every second and sends each one twice, as a sender does when it
+     * misses the ack. Acks whatever is sent to it, as team 3524.
+     */
+    struct BurstSender {
+        static constexpr uint64_t PeriodUs = 1000000;
+        static constexpr uint16_t TeamNumber = 3524;
+
+        RFM69 radio{0, 0, true, nullptr};
+        uint8_t burst = 0;
+        uint8_t sequence = 0;
+        uint64_t nextBurstUs = 0;
+
+        BurstSender()
+        {
+            radio.initialize(Radio::Frequency, PacketRadio::addressOf(TeamNumber),
+                Radio::NetworkId);
+        }
+
+        void update()
+        {
+            while (radio.receiveDone())
+            {
+                if (radio.ACKRequested())
+                {
+                    radio.sendACK();
+                }
+            }
+
+            if (Native::nowUs() < nextBurstUs)
+            {
+                return;
+            }
+
+            for (uint8_t i = 0; i < burst; i++)
+            {
+                Message message;
+                message.len = snprintf((char *)message.data, sizeof(message.data),
+                    "burst message %u", i);
+
+                uint8_t frame[Radio::MaxDataLen];
+                uint8_t len = PacketRadio::writeFrame(frame, sequence++, message);
+                radio.send(RF69_BROADCAST_ADDR, frame, len);
+                radio.send(RF69_BROADCAST_ADDR, frame, len);
+            }
+
+            nextBurstUs = Native::nowUs() + PeriodUs;
+        }
+    };
+
+    /**
+     * @brief Another board on the radio link that sends this one transfers
+     * of the same payload back to back, timing the ones that get through
+     */
+    struct TransferPeer {
+        RFM69 radio{0, 0, true, nullptr};
+        RadioTransfer transfer{[this](uint8_t address, const uint8_t *frame, uint8_t len)
+        {
+            radio.send(address, frame, len);
+        }};
+        std::vector<uint8_t> payload;
+        uint8_t boardAddress;
+        uint64_t firstUs = 0;
+        uint64_t lastDoneUs = 0;
+        uint32_t done = 0;
+
+        TransferPeer(uint16_t len)
+        {
+            radio.initialize(Radio::Frequency, 2, Radio::NetworkId);
+            boardAddress = PacketRadio::addressOf(configuration.teamNumber);
+
+            // Led by a kind the board doesn't act on, so it only counts them
+            payload.resize(std::max<uint16_t>(len, 1));
+            for (uint16_t i = 0; i < payload.size(); i++)
+            {
+                payload[i] = i == 0 ? 0 : i * 7;
+            }
+        }
+
+        void update()
+        {
+            uint64_t now = Native::nowUs();
+
+            while (radio.receiveDone())
+            {
+                transfer.receive(radio.SENDERID, radio.DATA, radio.DATALEN, now / 1000);
+            }
+
+            if (transfer.stats().sent != done)
+            {
+                done = transfer.stats().sent;
+                lastDoneUs = now;
+            }
+
+            if (!transfer.sending())
+            {
+                firstUs = firstUs == 0 ? now : firstUs;
+                transfer.send(boardAddress, payload.data(), payload.size());
+            }
+
+            transfer.update(now / 1000);
+        }
+
+        double bytesPerSecond() const
+        {
+            return lastDoneUs > firstUs ?
+                (double)done * payload.size() * 1000000 / (lastDoneUs - firstUs) : 0;
+        }
+    };
+
+    uint32_t fnv1a(const uint32_t *words, uint16_t count)
+    {
+        uint32_t hash = 2166136261u;
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            // Only the top three bytes go out on the wire
+            for (uint8_t shift = 24; shift >= 8; shift -= 8)
+            {
+                hash = (hash ^ ((words[i] >> shift) & 0xff)) * 16777619u;
+            }
+        }
+
+        return hash;
+    }
+
+    void recordFrame(uint8_t pin, const uint32_t *words, uint16_t count)
+    {
+        uint8_t port = pin == PinConstants::LED::Dout0 ? 0 : 1;
+        char field[32];
+
+        // Built up and written at once, since with -j both cores send frames
+        snprintf(field, sizeof(field), "%u,%llu,%u,%08x", port,
+            (unsigned long long)Native::nowUs(), frameCounts[port]++, fnv1a(words, count));
+        std::string line = field;
+
+        if (printPixels)
+        {
+            line += ",";
+            for (uint16_t i = 0; i < count; i++)
+            {
+                snprintf(field, sizeof(field), "%06x", words[i] >> 8);
+                line += field;
+            }
+        }
+
+        line += "\n";
+        fputs(line.c_str(), stdout);
+
+        Native::advanceUs(stallUs);
+    }
+
+    /**
+     * @brief One event per line: "<ms> w <hex bytes...>" for a controller
+     * write or "<ms> r" for a read. Blank lines and # comments are skipped.
+     */
+    bool loadScript(const char *path, std::vector<ScriptEvent> *events)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return false;
+        }
+
+        std::string line;
+        for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++)
+        {
+            std::istringstream fields(line.substr(0, line.find('#')));
+            uint32_t atMs;
+            std::string kind;
+
+            if (!(fields >> atMs))
+            {
+                continue;
+            }
+
+            ScriptEvent event;
+            event.atUs = (uint64_t)atMs * 1000;
+            fields >> kind;
+            event.isWrite = kind == "w";
+
+            unsigned int value;
+            while (fields >> std::hex >> value)
+            {
+                event.bytes.push_back(value);
+            }
+
+            if ((!event.isWrite && kind != "r") || (event.isWrite && event.bytes.empty()))
+            {
+                fprintf(stderr, "%s:%u: expected \"<ms> w <bytes>\" or \"<ms> r\"\n",
+                    path, lineNumber);
+                return false;
+            }
+
+            events->push_back(event);
+        }
+
+        std::stable_sort(events->begin(), events->end(),
+            [](const ScriptEvent &a, const ScriptEvent &b) { return a.atUs < b.atUs; });
+
+        return true;
+    }
+
+    void runEvent(const ScriptEvent &event)
+    {
+        if (event.isWrite)
+        {
+            Wire.simulateWrite(event.bytes.data(), event.bytes.size());
+            return;
+        }
+
+        fprintf(stderr, "read at %llu us:", (unsigned long long)Native::nowUs());
+        for (uint8_t value : Wire.simulateRead())
+        {
+            fprintf(stderr, " %02x", value);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    uint32_t framesSent = 0;
+
+    void countFrame(uint8_t pin, const uint32_t *words, uint16_t count)
+    {
+        framesSent++;
+    }
+
+    // Start, address byte with its ack and stop, then 9 bits per data byte
+    uint32_t busBits(size_t len)
+    {
+        return 11 + 9 * (len + 1);
+    }
+
+    /**
+     * @brief Makes the same zone change (SetPatternZone, ChangeColor, Pattern)
+     * the given number of times, first as three writes and then as one Batch,
+     * with a pass of both loops after each write. Prints the host time each
+     * took, the bus time the writes need at 400 kHz and how many frames were
+     * sent between the first and last write of a change.
+     */
+    void runThroughput(uint32_t changes)
+    {
+        const double BusHz = 400000;
+
+        Native::setFrameSink(countFrame);
+        setup();
+        setup1();
+
+        const uint8_t setPort[] = {0x05, 0x00};
+        Wire.simulateWrite(setPort, sizeof(setPort));
+        loop();
+        loop1();
+
+        printf("mode,changes,writes,commands,bus_bytes,bus_us,host_us,"
+            "commands_per_s_host,changes_per_s_bus,frames_mid_change\n");
+
+        for (bool batched : {false, true})
+        {
+            uint32_t writes = 0;
+            uint64_t busBytes = 0;
+            uint64_t busTotalBits = 0;
+            uint32_t framesMidChange = 0;
+            auto start = std::chrono::steady_clock::now();
+
+            for (uint32_t i = 0; i < changes; i++)
+            {
+                uint8_t zone = 1 + i % 3;
+                uint8_t green = i;
+
+                std::vector<std::vector<uint8_t>> frames;
+                if (batched)
+                {
+                    frames.push_back({0x15, 0x03, 0x04, 0x10, zone, 0x00, 0x00,
+                        0x04, 0x03, 0x00, green, 0xff, 0x05, 0x02, 0x07, 0x00, 0xff, 0xff});
+                }
+                else
+                {
+                    frames.push_back({0x10, zone, 0x00, 0x00});
+                    frames.push_back({0x03, 0x00, green, 0xff});
+                    frames.push_back({0x02, 0x07, 0x00, 0xff, 0xff});
+                }
+
+                uint32_t framesBefore = framesSent;
+                for (size_t f = 0; f < frames.size(); f++)
+                {
+                    if (f == frames.size() - 1)
+                    {
+                        framesMidChange += framesSent - framesBefore;
+                    }
+
+                    Wire.simulateWrite(frames[f].data(), frames[f].size());
+                    writes++;
+                    busBytes += frames[f].size();
+                    busTotalBits += busBits(frames[f].size());
+
+                    Native::advanceUs(busBits(frames[f].size()) * 1000000 / BusHz);
+                    loop();
+                    loop1();
+                }
+            }
+
+            double hostUs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count() / 1000.0;
+            double busUs = busTotalBits * 1000000 / BusHz;
+
+            printf("%s,%u,%u,%u,%llu,%.0f,%.0f,%.0f,%.0f,%u\n", batched ? "batch" : "single",
+                changes, writes, changes * 3, (unsigned long long)busBytes, busUs, hostUs,
+                changes * 3 * 1000000.0 / hostUs, changes * 1000000.0 / busUs, framesMidChange);
+        }
+    }
+}
+
+/**
+ * @brief Runs the firmware on the host with both cores interleaved on one
+ * thread, and prints every frame sent to either LED port as
+ * port,time_us,frame,hash (plus the wire bytes with -p). With -j, core0 gets
+ * a thread of its own so it can take render jobs alongside core1, and the
+ * wall time core1 spent per loop1 pass is printed at the end either way.
+ * -l makes every frame sent stall its core, as a slow render or show would.
+ * -r puts a timebase master on the radio link with the given latency, extra
+ * random delay, loss and clock drift, and prints how closely this board's
+ * network time tracked it. -m has another board send a burst of that many
+ * messages every second, each twice, for ReadRadioStats to count, and acks
+ * messages sent to team 3524; -m 0 only acks. -x has
+ * another board send this one transfers of that many bytes back to back over
+ * a link that loses the given share of messages, and prints the throughput.
+ * With -b, runs the pattern benchmark instead, and with -f the FFT benchmark.
+ * -c makes that many zone changes as single commands and then as batches,
+ * and prints how long each took on the host and would take on the bus.
+ *
+ * Usage: simulator [-d data dir] [-t run ms] [-s loop step us] [-l stall us]
+ *     [-r latency us[,jitter us[,loss %[,drift ppm]]]] [-m burst]
+ *     [-x bytes[,loss %]] [-c changes] [-p] [-j] [-b] [-f] [script]
+ */
+int main(int argc, char **argv)
+{
+    const char *dataDir = "data";
+    uint32_t runMs = 10000;
+    uint32_t stepUs = 100;
+    bool benchmark = false;
+    bool fftBenchmark = false;
+    uint32_t throughputChanges = 0;
+    bool threaded = false;
+    Native::RadioLink link = {};
+    std::unique_ptr<SyncMaster> syncMaster;
+    std::unique_ptr<BurstSender> burstSender;
+    std::unique_ptr<TransferPeer> transferPeer;
+    int option;
+
+    while ((option = getopt(argc, argv, "d:t:s:l:r:m:x:c:pjbf")) != -1)
+    {
+        switch (option)
+        {
+        case 'd':
+            dataDir = optarg;
+            break;
+        case 't':
+            runMs = strtoul(optarg, nullptr, 10);
+            break;
+        case 's':
+            stepUs = strtoul(optarg, nullptr, 10);
+            break;
+        case 'l':
+            stallUs = strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+        {
+            unsigned int loss = 0;
+            syncMaster.reset(new SyncMaster());
+            sscanf(optarg, "%u,%u,%u,%d", &link.latencyUs, &link.jitterUs, &loss,
+                &syncMaster->driftPpm);
+            link.lossPercent = loss;
+            break;
+        }
+        case 'm':
+            burstSender.reset(new BurstSender());
+            burstSender->burst = strtoul(optarg, nullptr, 10);
+            break;
+        case 'x':
+        {
+            unsigned int bytes = 0;
+            unsigned int loss = 0;
+            sscanf(optarg, "%u,%u", &bytes, &loss);
+            transferPeer.reset(new TransferPeer(std::min<unsigned int>(bytes, Radio::MaxTransferLen)));
+            link.lossPercent = loss;
+            break;
+        }
+        case 'c':
+            throughputChanges = strtoul(optarg, nullptr, 10);
+            break;
+        case 'p':
+            printPixels = true;
+            break;
+        case 'j':
+            threaded = true;
+            break;
+        case 'b':
+            benchmark = true;
+            break;
+        case 'f':
+            fftBenchmark = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d data dir] [-t run ms] [-s loop step us] [-l stall us] "
+                "[-r latency us[,jitter us[,loss %%[,drift ppm]]]] [-m burst] [-x bytes[,loss %%]] "
+                "[-c changes] [-p] [-j] [-b] [-f] [script]\n",
+                argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<ScriptEvent> events;
+    if (optind < argc && !loadScript(argv[optind], &events))
+    {
+        return 1;
+    }
+
+    LittleFS.setRoot(dataDir);
+
+    if (benchmark)
+    {
+        Stream console(stdout);
+        PatternBenchmark::run(console);
+        return 0;
+    }
+
+    if (fftBenchmark)
+    {
+        Stream console(stdout);
+        return FftBenchmark::run(console) ? 0 : 1;
+    }
+
+    if (throughputChanges > 0)
+    {
+        runThroughput(throughputChanges);
+        return 0;
+    }
+
+    Native::setFrameSink(recordFrame);
+    Native::setRadioLink(link);
+
+    printf("port,time_us,frame,hash%s\n", printPixels ? ",pixels" : "");
+
+    setup();
+    setup1();
+
+    std::atomic<bool> running{true};
+    std::thread core0;
+    if (threaded)
+    {
+        core0 = std::thread([&running]()
+        {
+            Native::setCoreNum(0);
+            while (running.load(std::memory_order_relaxed))
+            {
+                loop();
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    uint64_t startUs = Native::nowUs();
+    size_t nextEvent = 0;
+    uint64_t loop1Ns = 0;
+    uint32_t loop1Passes = 0;
+
+    while (Native::nowUs() - startUs < (uint64_t)runMs * 1000)
+    {
+        while (nextEvent < events.size() &&
+            events[nextEvent].atUs <= Native::nowUs() - startUs)
+        {
+            runEvent(events[nextEvent++]);
+        }
+
+        if (syncMaster)
+        {
+            syncMaster->update();
+        }
+
+        if (burstSender)
+        {
+            burstSender->update();
+        }
+
+        if (transferPeer)
+        {
+            transferPeer->update();
+        }
+
+        if (!threaded)
+        {
+            loop();
+        }
+
+        auto passStart = std::chrono::steady_clock::now();
+        loop1();
+        loop1Ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - passStart).count();
+        loop1Passes++;
+
+        Native::advanceUs(stepUs > 0 ? stepUs : 1);
+    }
+
+    running = false;
+    if (core0.joinable())
+    {
+        core0.join();
+    }
+
+    fprintf(stderr, "loop1: %u passes, %.2f us average wall time\n", loop1Passes,
+        loop1Passes ? loop1Ns / 1000.0 / loop1Passes : 0.0);
+
+    if (syncMaster)
+    {
+        fprintf(stderr, "sync: %u beacons, %u lost, worst error %lld us after the first %llu ms, "
+            "%lld us at the end, drift %d ppm\n", syncMaster->beacons, Native::radioLost(),
+            (long long)syncMaster->worstErrorUs,
+            (unsigned long long)(SyncMaster::SettleUs / 1000),
+            (long long)syncMaster->lastErrorUs, timebase.driftPpm());
+    }
+
+    if (syncMaster || burstSender || transferPeer)
+    {
+        Native::RadioAirtime airtime =
+            Native::radioAirtime(PacketRadio::addressOf(configuration.teamNumber));
+        fprintf(stderr, "radio: %u frames sent, core0 held up %.1f ms in all, "
+            "%.2f ms at most\n", airtime.frames, airtime.totalUs / 1000.0,
+            airtime.longestUs / 1000.0);
+    }
+
+    if (transferPeer)
+    {
+        const TransferStats &stats = transferPeer->transfer.stats();
+        fprintf(stderr, "transfer: %u transfers of %u bytes sent, %u failed, %u fragments, "
+            "%u retransmitted, %u lost, %.0f bytes/s\n", stats.sent,
+            (unsigned int)transferPeer->payload.size(), stats.failed, stats.fragments,
+            stats.retransmits, Native::radioLost(), transferPeer->bytesPerSecond());
+    }
+
+    return 0;
+}
+#endif
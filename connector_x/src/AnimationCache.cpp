@@ -0,0 +1,459 @@
+#include "AnimationCache.h"
+
+#include <FastLED_NeoMatrix.h>
+#include <LittleFS.h>
+
+#include "AnimationContainer.h"
+
+namespace
+{
+    using namespace AnimationContainer;
+
+    // Open /<name>.anim and read its header, if it's a container for this matrix
+    File openContainer(const String &path, Header *header,
+        const MatrixConfiguration &matrixConfig)
+    {
+        File file = LittleFS.open(path, "r");
+        if (!file)
+        {
+            return file;
+        }
+
+        bool valid = file.readBytes((char *)header, sizeof(*header)) == sizeof(*header) &&
+            memcmp(header->magic, Magic, sizeof(Magic)) == 0 &&
+            header->version == Version &&
+            header->width == matrixConfig.width &&
+            header->height == matrixConfig.height &&
+            header->frameCount > 0 &&
+            header->dataSize <= file.size() - sizeof(*header) &&
+            header->frameCount * sizeof(FrameEntry) +
+                header->paletteSize * sizeof(uint16_t) <= header->dataSize;
+
+        if (!valid)
+        {
+            file.close();
+            return File();
+        }
+
+        return file;
+    }
+
+    // Draw through the matrix library, so frames come out in its wiring order
+    void drawFrame(const Header &header, const uint8_t *palette,
+        const uint8_t *data, uint16_t length, CRGB *out, uint8_t flags)
+    {
+        FastLED_NeoMatrix matrix(out, header.width, header.height, flags);
+        uint16_t ledCount = header.width * header.height;
+        uint16_t pixel = 0;
+
+        auto colorAt = [&](uint8_t index) {
+            uint16_t color = 0;
+            if (index < header.paletteSize)
+            {
+                memcpy(&color, &palette[index * sizeof(uint16_t)], sizeof(color));
+            }
+            return color;
+        };
+
+        switch (header.encoding)
+        {
+        case Encoding::Raw565:
+            for (; pixel < ledCount && (pixel + 1) * sizeof(uint16_t) <= length; pixel++)
+            {
+                uint16_t color;
+                memcpy(&color, &data[pixel * sizeof(uint16_t)], sizeof(color));
+                matrix.drawPixel(pixel % header.width, pixel / header.width, color);
+            }
+            break;
+
+        case Encoding::Indexed:
+            for (; pixel < ledCount && pixel < length; pixel++)
+            {
+                matrix.drawPixel(pixel % header.width, pixel / header.width, colorAt(data[pixel]));
+            }
+            break;
+
+        case Encoding::IndexedRle:
+            for (uint16_t i = 0; i + 1 < length; i += 2)
+            {
+                uint16_t color = colorAt(data[i + 1]);
+                for (uint8_t run = 0; run < data[i] && pixel < ledCount; run++, pixel++)
+                {
+                    matrix.drawPixel(pixel % header.width, pixel / header.width, color);
+                }
+            }
+            break;
+        }
+    }
+}
+
+AnimationCache animationCache(Animation::spriteCacheBudget);
+
+AnimationCache::AnimationCache(size_t budgetBytes)
+    : _budgetBytes(budgetBytes)
+{
+    mutex_init(&_mtx);
+}
+
+AnimationCache::~AnimationCache()
+{
+    clear();
+}
+
+bool AnimationCache::copyFrame(const char *name, uint16_t frame, CRGB *out,
+    const MatrixConfiguration &matrixConfig)
+{
+    mutex_enter_blocking(&_mtx);
+
+    bool copied = false;
+
+    if (listed(_oversized, name))
+    {
+        // Too big for the cache, so decode just this frame from the filesystem
+        copied = decodeFrame(name, frame, out, matrixConfig);
+    }
+    else if (!listed(_unloadable, name))
+    {
+        const CRGB *cached = getFrame(name, frame, matrixConfig);
+        if (cached)
+        {
+            memcpy((void *)out, cached, sizeof(CRGB) * matrixConfig.width * matrixConfig.height);
+            copied = true;
+        }
+        else if (listed(_oversized, name))
+        {
+            // It was just found not to fit
+            copied = decodeFrame(name, frame, out, matrixConfig);
+        }
+    }
+
+    if (!copied)
+    {
+        _missingFrames++;
+    }
+
+    mutex_exit(&_mtx);
+
+    return copied;
+}
+
+const CRGB *AnimationCache::getFrame(const char *name, uint16_t frame,
+    const MatrixConfiguration &matrixConfig)
+{
+    CachedAnimation *animation = find(name);
+
+    if (animation)
+    {
+        _hits++;
+    }
+    else
+    {
+        _misses++;
+        animation = load(name, matrixConfig);
+    }
+
+    if (!animation || frame >= animation->frameCount)
+    {
+        return nullptr;
+    }
+
+    animation->lastUsed = ++_tick;
+
+    return &animation->frames[frame * animation->ledCount];
+}
+
+uint16_t AnimationCache::frameDelay(const char *name, uint16_t frame)
+{
+    mutex_enter_blocking(&_mtx);
+
+    CachedAnimation *animation = find(name);
+    uint16_t delayMs = 0;
+
+    if (animation && animation->delays && frame < animation->frameCount)
+    {
+        delayMs = animation->delays[frame];
+    }
+
+    mutex_exit(&_mtx);
+
+    return delayMs;
+}
+
+uint32_t AnimationCache::stepAt(const char *name, uint32_t elapsedMs, uint16_t defaultDelayMs)
+{
+    mutex_enter_blocking(&_mtx);
+
+    CachedAnimation *animation = find(name);
+
+    if (!animation || !animation->delays)
+    {
+        mutex_exit(&_mtx);
+        return elapsedMs / defaultDelayMs;
+    }
+
+    uint32_t cycleMs = 0;
+    for (uint16_t frame = 0; frame < animation->frameCount; frame++)
+    {
+        cycleMs += animation->delays[frame] ? animation->delays[frame] : defaultDelayMs;
+    }
+
+    uint32_t step = elapsedMs / cycleMs * animation->frameCount;
+    uint32_t remainingMs = elapsedMs % cycleMs;
+
+    for (uint16_t frame = 0; frame < animation->frameCount; frame++)
+    {
+        uint16_t delayMs = animation->delays[frame] ? animation->delays[frame] : defaultDelayMs;
+        if (remainingMs < delayMs)
+        {
+            break;
+        }
+
+        remainingMs -= delayMs;
+        step++;
+    }
+
+    mutex_exit(&_mtx);
+
+    return step;
+}
+
+bool AnimationCache::decodeFrame(const char *name, uint16_t frame, CRGB *out,
+    const MatrixConfiguration &matrixConfig)
+{
+    using namespace AnimationContainer;
+
+    Header header;
+    File file = openContainer(containerPath(name), &header, matrixConfig);
+    if (!file)
+    {
+        return false;
+    }
+
+    size_t tableSize = header.frameCount * sizeof(FrameEntry);
+    size_t paletteSize = header.paletteSize * sizeof(uint16_t);
+    size_t frameDataSize = header.dataSize - tableSize - paletteSize;
+
+    // The frame's table entry, the palette and the frame's own bytes
+    FrameEntry entry;
+    bool valid = frame < header.frameCount &&
+        file.seek(sizeof(Header) + frame * sizeof(FrameEntry)) &&
+        file.readBytes((char *)&entry, sizeof(entry)) == sizeof(entry) &&
+        entry.offset + entry.length <= frameDataSize;
+
+    uint8_t *bytes = nullptr;
+    if (valid)
+    {
+        bytes = new uint8_t[paletteSize + entry.length];
+        valid = file.seek(sizeof(Header) + tableSize) &&
+            file.readBytes((char *)bytes, paletteSize) == paletteSize &&
+            file.seek(sizeof(Header) + tableSize + paletteSize + entry.offset) &&
+            file.readBytes((char *)bytes + paletteSize, entry.length) == entry.length;
+    }
+
+    file.close();
+
+    if (valid)
+    {
+        memset((void *)out, 0, sizeof(CRGB) * header.width * header.height);
+        drawFrame(header, bytes, bytes + paletteSize, entry.length, out, matrixConfig.flags);
+    }
+
+    delete[] bytes;
+    return valid;
+}
+
+void AnimationCache::clear()
+{
+    mutex_enter_blocking(&_mtx);
+
+    while (!_animations.empty())
+    {
+        evict(_animations.size() - 1);
+    }
+
+    _unloadable.clear();
+    _oversized.clear();
+
+    mutex_exit(&_mtx);
+}
+
+CachedAnimation *AnimationCache::find(const char *name)
+{
+    for (auto &animation : _animations)
+    {
+        if (animation.name == name)
+        {
+            return &animation;
+        }
+    }
+
+    return nullptr;
+}
+
+CachedAnimation *AnimationCache::load(const char *name,
+    const MatrixConfiguration &matrixConfig)
+{
+    uint16_t frameCount = 0;
+    uint16_t *delays = nullptr;
+    bool oversized = false;
+    CRGB *frames = loadContainer(name, &frameCount, &delays, &oversized, matrixConfig);
+
+    if (!frames)
+    {
+        // Either way, don't read and check the whole file again next frame
+        (oversized ? _oversized : _unloadable).push_back(String(name));
+        return nullptr;
+    }
+
+    uint16_t ledCount = matrixConfig.width * matrixConfig.height;
+
+    _animations.push_back(CachedAnimation{
+        .name = String(name),
+        .frameCount = frameCount,
+        .ledCount = ledCount,
+        .frames = frames,
+        .delays = delays,
+        .lastUsed = _tick,
+    });
+    _usedBytes += _animations.back().sizeBytes();
+
+    // Serial.printf("Cached %s: %u frames\r\n", name, frameCount);
+
+    return &_animations.back();
+}
+
+CRGB *AnimationCache::loadContainer(const char *name, uint16_t *frameCount,
+    uint16_t **delays, bool *oversized, const MatrixConfiguration &matrixConfig)
+{
+    using namespace AnimationContainer;
+
+    Header header;
+    File file = openContainer(containerPath(name), &header, matrixConfig);
+    if (!file)
+    {
+        return nullptr;
+    }
+
+    // One sequential read; nothing touches the filesystem after this
+    uint8_t *body = new uint8_t[header.dataSize];
+    bool valid = file.readBytes((char *)body, header.dataSize) == header.dataSize &&
+        crc32(body, header.dataSize) == header.crc;
+
+    file.close();
+
+    uint16_t ledCount = header.width * header.height;
+    size_t tableSize = header.frameCount * sizeof(FrameEntry);
+    size_t paletteSize = header.paletteSize * sizeof(uint16_t);
+    size_t bytes = sizeof(CRGB) * header.frameCount * ledCount;
+
+    // Delays are only kept if a frame has one of its own
+    bool hasDelays = false;
+    for (uint16_t frame = 0; valid && frame < header.frameCount; frame++)
+    {
+        FrameEntry entry;
+        memcpy(&entry, &body[frame * sizeof(FrameEntry)], sizeof(entry));
+        hasDelays |= entry.delayMs != 0;
+    }
+
+    if (hasDelays)
+    {
+        bytes += sizeof(uint16_t) * header.frameCount;
+    }
+
+    if (!valid || !makeRoom(bytes))
+    {
+        *oversized = valid;
+        delete[] body;
+        return nullptr;
+    }
+
+    CRGB *frames = new CRGB[header.frameCount * ledCount];
+    memset((void *)frames, 0, sizeof(CRGB) * header.frameCount * ledCount);
+
+    if (hasDelays)
+    {
+        *delays = new uint16_t[header.frameCount];
+    }
+
+    const uint8_t *palette = body + tableSize;
+    const uint8_t *frameData = palette + paletteSize;
+    size_t frameDataSize = header.dataSize - tableSize - paletteSize;
+
+    for (uint16_t frame = 0; frame < header.frameCount; frame++)
+    {
+        FrameEntry entry;
+        memcpy(&entry, &body[frame * sizeof(FrameEntry)], sizeof(entry));
+
+        if (hasDelays)
+        {
+            (*delays)[frame] = entry.delayMs;
+        }
+
+        if (entry.offset + entry.length > frameDataSize)
+        {
+            continue;
+        }
+
+        drawFrame(header, palette, &frameData[entry.offset], entry.length,
+            &frames[frame * ledCount], matrixConfig.flags);
+    }
+
+    delete[] body;
+
+    *frameCount = header.frameCount;
+    return frames;
+}
+
+bool AnimationCache::makeRoom(size_t bytes)
+{
+    if (bytes > _budgetBytes)
+    {
+        return false;
+    }
+
+    while (_usedBytes + bytes > _budgetBytes && !_animations.empty())
+    {
+        size_t oldest = 0;
+        for (size_t i = 1; i < _animations.size(); i++)
+        {
+            if (_animations[i].lastUsed < _animations[oldest].lastUsed)
+            {
+                oldest = i;
+            }
+        }
+
+        evict(oldest);
+        _evictions++;
+    }
+
+    return true;
+}
+
+void AnimationCache::evict(size_t index)
+{
+    auto &animation = _animations[index];
+
+    _usedBytes -= animation.sizeBytes();
+    delete[] animation.frames;
+    delete[] animation.delays;
+
+    _animations.erase(_animations.begin() + index);
+}
+
+String AnimationCache::containerPath(const char *name)
+{
+    return String("/") + String(name) + String(".anim");
+}
+
+bool AnimationCache::listed(const std::vector<String> &names, const char *name)
+{
+    for (auto &listedName : names)
+    {
+        if (listedName == name)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
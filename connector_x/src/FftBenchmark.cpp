@@ -0,0 +1,312 @@
+#include "FftBenchmark.h"
+
+#include "FixedFFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <arduinoFFT.h>
+#else
+#include <chrono>
+#endif
+
+namespace
+{
+    // Enough transforms at every size for the timing to settle
+    constexpr uint32_t SamplesTimed = 65536;
+
+    inline uint64_t now()
+    {
+#ifdef ARDUINO_ARCH_RP2040
+        return rp2040.getCycleCount64();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    inline uint64_t toNs(uint64_t ticks)
+    {
+#ifdef ARDUINO_ARCH_RP2040
+        return ticks * 1000000000ull / F_CPU;
+#else
+        return ticks;
+#endif
+    }
+
+    /**
+     * @brief A loud tone on a bin, a quieter one between bins and some
+     * noise, about as loud as the microphone's samples get
+     */
+    void makeSignal(int16_t *samples, uint16_t n)
+    {
+        const double twoPi = 6.28318530717958647692;
+        uint32_t seed = 12345;
+
+        for (uint16_t i = 0; i < n; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            int32_t noise = (int32_t)(seed >> 23) - 256;
+
+            samples[i] = 12000 * sin(twoPi * i * (n / 8) / n) +
+                2000 * sin(twoPi * i * (0.3 * n + 0.37) / n) + noise;
+        }
+    }
+
+    /**
+     * @brief Radix-2 float FFT, as plain as it gets, so there's a reference
+     * row on the host as well as on the board
+     */
+    class FloatFFT
+    {
+    public:
+        explicit FloatFFT(uint16_t n) : _n(n), _cosines(new float[n / 2]),
+            _sines(new float[n / 2])
+        {
+            const double twoPi = 6.28318530717958647692;
+            for (uint16_t i = 0; i < n / 2; i++)
+            {
+                _cosines[i] = cos(twoPi * i / n);
+                _sines[i] = sin(twoPi * i / n);
+            }
+        }
+
+        ~FloatFFT()
+        {
+            delete[] _cosines;
+            delete[] _sines;
+        }
+
+        void transform(float *re, float *im)
+        {
+            for (uint16_t i = 1, j = 0; i < _n; i++)
+            {
+                uint16_t bit = _n >> 1;
+                for (; j & bit; bit >>= 1)
+                {
+                    j ^= bit;
+                }
+                j ^= bit;
+
+                if (i < j)
+                {
+                    std::swap(re[i], re[j]);
+                    std::swap(im[i], im[j]);
+                }
+            }
+
+            for (uint16_t span = 1; span < _n; span <<= 1)
+            {
+                uint16_t stride = _n / (2 * span);
+                for (uint16_t start = 0; start < _n; start += 2 * span)
+                {
+                    for (uint16_t i = 0; i < span; i++)
+                    {
+                        float wRe = _cosines[i * stride];
+                        float wIm = -_sines[i * stride];
+                        uint16_t a = start + i;
+                        uint16_t b = a + span;
+
+                        float tRe = re[b] * wRe - im[b] * wIm;
+                        float tIm = re[b] * wIm + im[b] * wRe;
+                        re[b] = re[a] - tRe;
+                        im[b] = im[a] - tIm;
+                        re[a] += tRe;
+                        im[a] += tIm;
+                    }
+                }
+            }
+        }
+
+    private:
+        uint16_t _n;
+        float *_cosines;
+        float *_sines;
+    };
+
+    /**
+     * @brief Print the accuracy columns of a row
+     *
+     * @param magnitudes bins 0 to n / 2, scaled down by n as FixedFFT's are
+     * @return whether they're within the limits
+     */
+    bool printAccuracy(Stream &out, const int16_t *windowed, const double *magnitudes,
+        uint16_t n)
+    {
+        const double twoPi = 6.28318530717958647692;
+        double *cosines = new double[n];
+        double *sines = new double[n];
+
+        for (uint16_t i = 0; i < n; i++)
+        {
+            cosines[i] = cos(twoPi * i / n);
+            sines[i] = sin(twoPi * i / n);
+        }
+
+        double signal = 0;
+        double error = 0;
+        double worst = 0;
+
+        for (uint16_t k = 0; k <= n / 2; k++)
+        {
+            double sumRe = 0;
+            double sumIm = 0;
+            for (uint16_t i = 0; i < n; i++)
+            {
+                uint16_t angle = ((uint32_t)k * i) % n;
+                sumRe += windowed[i] * cosines[angle];
+                sumIm -= windowed[i] * sines[angle];
+            }
+
+            double expected = sqrt(sumRe * sumRe + sumIm * sumIm) / n;
+            double diff = magnitudes[k] - expected;
+
+            signal += expected * expected;
+            error += diff * diff;
+            worst = std::max(worst, fabs(diff));
+        }
+
+        delete[] cosines;
+        delete[] sines;
+
+        double snrDb = 10 * log10(signal / std::max(error, 1e-12));
+        bool pass = snrDb >= FftBenchmark::MinSnrDb && worst <= FftBenchmark::MaxWorstError;
+
+        out.printf("%.1f,%.2f,%u\n", snrDb, worst, pass);
+
+        return pass;
+    }
+}
+
+bool FftBenchmark::run(Stream &out)
+{
+    out.printf("size,engine,us_per_transform,snr_db,worst_error,pass\n");
+
+    bool pass = true;
+
+    int16_t *input = new int16_t[FFT::MaxSampleCount];
+    int16_t *windowed = new int16_t[FFT::MaxSampleCount];
+    int16_t *re = new int16_t[FFT::MaxSampleCount];
+    int16_t *im = new int16_t[FFT::MaxSampleCount];
+    uint16_t *magnitudes = new uint16_t[FFT::MaxSampleCount / 2];
+    float *floatRe = new float[FFT::MaxSampleCount];
+    float *floatIm = new float[FFT::MaxSampleCount];
+    float *floatMagnitudes = new float[FFT::MaxSampleCount / 2];
+    double *checked = new double[FFT::MaxSampleCount / 2 + 1];
+
+    for (uint16_t n = FFT::MinSampleCount; n <= FFT::MaxSampleCount; n <<= 1)
+    {
+        uint32_t runs = SamplesTimed / n;
+        uint64_t totalNs = 0;
+
+        makeSignal(input, n);
+        memcpy(windowed, input, n * sizeof(int16_t));
+        FixedFFT::window(windowed, n);
+
+        // Every engine windows the same way, with FixedFFT's table, inside
+        // the timed part
+        for (uint32_t run = 0; run < runs; run++)
+        {
+            memcpy(re, input, n * sizeof(int16_t));
+            memset(im, 0, n * sizeof(int16_t));
+
+            uint64_t start = now();
+            FixedFFT::window(re, n);
+            FixedFFT::transform(re, im, n);
+            for (uint16_t k = 0; k < n / 2; k++)
+            {
+                magnitudes[k] = FixedFFT::magnitude(re[k], im[k]);
+            }
+            totalNs += toNs(now() - start);
+        }
+
+        out.printf("%u,q15,%.2f,", n, totalNs / 1000.0 / runs);
+
+        // The timed loop left out bin n / 2, which the check wants too
+        for (uint16_t k = 0; k <= n / 2; k++)
+        {
+            checked[k] = FixedFFT::magnitude(re[k], im[k]);
+        }
+        pass &= printAccuracy(out, windowed, checked, n);
+
+        FloatFFT floatFft(n);
+        totalNs = 0;
+
+        for (uint32_t run = 0; run < runs; run++)
+        {
+            memcpy(re, input, n * sizeof(int16_t));
+
+            uint64_t start = now();
+            FixedFFT::window(re, n);
+            for (uint16_t i = 0; i < n; i++)
+            {
+                floatRe[i] = re[i];
+                floatIm[i] = 0;
+            }
+            floatFft.transform(floatRe, floatIm);
+            for (uint16_t k = 0; k < n / 2; k++)
+            {
+                floatMagnitudes[k] = sqrtf(floatRe[k] * floatRe[k] + floatIm[k] * floatIm[k]);
+            }
+            totalNs += toNs(now() - start);
+        }
+
+        out.printf("%u,float,%.2f,", n, totalNs / 1000.0 / runs);
+
+        for (uint16_t k = 0; k <= n / 2; k++)
+        {
+            checked[k] = sqrt((double)floatRe[k] * floatRe[k] +
+                (double)floatIm[k] * floatIm[k]) / n;
+        }
+        pass &= printAccuracy(out, windowed, checked, n);
+
+#ifdef ARDUINO_ARCH_RP2040
+        float *vReal = new float[n];
+        float *vImag = new float[n];
+        ArduinoFFT<float> fft(vReal, vImag, n, FFT::SampleFrequencyHz);
+        totalNs = 0;
+
+        for (uint32_t run = 0; run < runs; run++)
+        {
+            memcpy(re, input, n * sizeof(int16_t));
+
+            // FixedFFT's window rather than windowing(), so the rows compare
+            uint64_t start = now();
+            FixedFFT::window(re, n);
+            for (uint16_t i = 0; i < n; i++)
+            {
+                vReal[i] = re[i];
+                vImag[i] = 0;
+            }
+            fft.compute(FFTDirection::Forward);
+            fft.complexToMagnitude();
+            totalNs += toNs(now() - start);
+        }
+
+        out.printf("%u,arduinofft,%.2f,", n, totalNs / 1000.0 / runs);
+
+        // complexToMagnitude() leaves the magnitudes in vReal
+        for (uint16_t k = 0; k <= n / 2; k++)
+        {
+            checked[k] = vReal[k] / n;
+        }
+        pass &= printAccuracy(out, windowed, checked, n);
+
+        delete[] vReal;
+        delete[] vImag;
+#endif
+    }
+
+    delete[] input;
+    delete[] windowed;
+    delete[] re;
+    delete[] im;
+    delete[] magnitudes;
+    delete[] floatRe;
+    delete[] floatIm;
+    delete[] floatMagnitudes;
+    delete[] checked;
+
+    return pass;
+}
@@ -0,0 +1,190 @@
+#include "FixedFFT.h"
+
+#include <array>
+#include <utility>
+
+namespace
+{
+    constexpr uint16_t TableSize = FFT::MaxSampleCount;
+    constexpr uint16_t QuarterTurn = TableSize / 4;
+    constexpr double HalfPi = 1.57079632679489661923;
+
+    static_assert((TableSize & (TableSize - 1)) == 0 && TableSize >= 4,
+        "The tables need a power of two size");
+
+    // Taylor series, good to well under a Q15 step for x in [0, pi/2]
+    constexpr double quarterSin(double x)
+    {
+        double term = x;
+        double sum = x;
+        for (int i = 1; i < 10; i++)
+        {
+            term *= -x * x / ((2 * i) * (2 * i + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // sin(2 pi i / TableSize)
+    constexpr double sinOfIndex(uint32_t i)
+    {
+        i %= TableSize;
+        double x = HalfPi * (i % QuarterTurn) / QuarterTurn;
+
+        switch (i / QuarterTurn)
+        {
+        case 0:
+            return quarterSin(x);
+        case 1:
+            return quarterSin(HalfPi - x);
+        case 2:
+            return -quarterSin(x);
+        default:
+            return -quarterSin(HalfPi - x);
+        }
+    }
+
+    constexpr int16_t toQ15(double value)
+    {
+        int32_t q = (int32_t)(value * 32768 + (value < 0 ? -0.5 : 0.5));
+        return q > 32767 ? 32767 : (q < -32768 ? -32768 : q);
+    }
+
+    constexpr std::array<int16_t, TableSize> makeSines()
+    {
+        std::array<int16_t, TableSize> table = {};
+        for (uint16_t i = 0; i < TableSize; i++)
+        {
+            table[i] = toQ15(sinOfIndex(i));
+        }
+        return table;
+    }
+
+    // Periodic Hamming, so every smaller size is this one sampled at a stride
+    constexpr std::array<int16_t, TableSize> makeWindow()
+    {
+        std::array<int16_t, TableSize> table = {};
+        for (uint16_t i = 0; i < TableSize; i++)
+        {
+            table[i] = toQ15(0.54 - 0.46 * sinOfIndex(i + QuarterTurn));
+        }
+        return table;
+    }
+
+    constexpr std::array<int16_t, TableSize> sines = makeSines();
+    constexpr std::array<int16_t, TableSize> hamming = makeWindow();
+
+    inline int32_t mulQ15(int32_t a, int32_t b)
+    {
+        return (a * b + 0x4000) >> 15;
+    }
+
+    void bitReverse(int16_t *re, int16_t *im, uint16_t n)
+    {
+        for (uint16_t i = 1, j = 0; i < n; i++)
+        {
+            uint16_t bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+            {
+                j ^= bit;
+            }
+            j ^= bit;
+
+            if (i < j)
+            {
+                std::swap(re[i], re[j]);
+                std::swap(im[i], im[j]);
+            }
+        }
+    }
+}
+
+bool FixedFFT::supports(uint16_t n)
+{
+    return n >= FFT::MinSampleCount && n <= FFT::MaxSampleCount && (n & (n - 1)) == 0;
+}
+
+void FixedFFT::window(int16_t *samples, uint16_t n)
+{
+    uint16_t stride = TableSize / n;
+    for (uint16_t i = 0; i < n; i++)
+    {
+        samples[i] = mulQ15(samples[i], hamming[i * stride]);
+    }
+}
+
+void FixedFFT::transform(int16_t *re, int16_t *im, uint16_t n)
+{
+    bitReverse(re, im, n);
+
+    // The first two stages only ever multiply by 1 and -j, so they're done
+    // together as one radix-4 pass with no multiplies, halving twice
+    for (uint16_t i = 0; i < n; i += 4)
+    {
+        int32_t sumRe0 = re[i] + re[i + 1];
+        int32_t sumIm0 = im[i] + im[i + 1];
+        int32_t diffRe0 = re[i] - re[i + 1];
+        int32_t diffIm0 = im[i] - im[i + 1];
+        int32_t sumRe1 = re[i + 2] + re[i + 3];
+        int32_t sumIm1 = im[i + 2] + im[i + 3];
+        int32_t diffRe1 = re[i + 2] - re[i + 3];
+        int32_t diffIm1 = im[i + 2] - im[i + 3];
+
+        re[i] = (sumRe0 + sumRe1) >> 2;
+        im[i] = (sumIm0 + sumIm1) >> 2;
+        re[i + 2] = (sumRe0 - sumRe1) >> 2;
+        im[i + 2] = (sumIm0 - sumIm1) >> 2;
+        // diff1 times -j
+        re[i + 1] = (diffRe0 + diffIm1) >> 2;
+        im[i + 1] = (diffIm0 - diffRe1) >> 2;
+        re[i + 3] = (diffRe0 - diffIm1) >> 2;
+        im[i + 3] = (diffIm0 + diffRe1) >> 2;
+    }
+
+    for (uint16_t half = 4; half < n; half <<= 1)
+    {
+        uint16_t stride = TableSize / (2 * half);
+
+        for (uint16_t k = 0; k < half; k++)
+        {
+            // e^(-2 pi j k / 2 half) = cos - j sin
+            int32_t cosine = sines[k * stride + QuarterTurn];
+            int32_t sine = sines[k * stride];
+
+            for (uint16_t i = k; i < n; i += 2 * half)
+            {
+                uint16_t j = i + half;
+                int32_t tRe = mulQ15(re[j], cosine) + mulQ15(im[j], sine);
+                int32_t tIm = mulQ15(im[j], cosine) - mulQ15(re[j], sine);
+
+                re[j] = (re[i] - tRe) >> 1;
+                im[j] = (im[i] - tIm) >> 1;
+                re[i] = (re[i] + tRe) >> 1;
+                im[i] = (im[i] + tIm) >> 1;
+            }
+        }
+    }
+}
+
+uint16_t FixedFFT::magnitude(int16_t re, int16_t im)
+{
+    // Up to 2^31, so summed unsigned
+    uint32_t square = (uint32_t)((int32_t)re * re) + (uint32_t)((int32_t)im * im);
+
+    // Integer square root, one result bit at a time
+    uint32_t root = 0;
+    for (uint32_t bit = 1u << 30; bit; bit >>= 2)
+    {
+        if (square >= root + bit)
+        {
+            square -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+    }
+
+    return root;
+}
@@ -0,0 +1,191 @@
+#include "LedOutput.h"
+
+#include <hardware/clocks.h>
+
+#include <math.h>
+
+LedOutput ledOutputs[PinConstants::LED::NumPorts];
+
+namespace
+{
+    // ws2812.pio from pico-examples: out x, 1 side 0 [2] / jmp !x, 3 side 1 [1] /
+    // jmp 0 side 1 [4] / nop side 0 [4]
+    constexpr uint8_t Ws2812CyclesPerBit = 2 + 5 + 3;
+    const uint16_t ws2812Instructions[] = {0x6221, 0x1123, 0x1400, 0xa442};
+    const pio_program_t ws2812Program = {
+        .instructions = ws2812Instructions,
+        .length = 4,
+        .origin = -1,
+    };
+
+    int ws2812Offset = -1;
+}
+
+bool PioLedTransport::begin(uint8_t pin)
+{
+    _pio = pio0;
+
+    if (ws2812Offset < 0)
+    {
+        ws2812Offset = pio_add_program(_pio, &ws2812Program);
+    }
+
+    int sm = pio_claim_unused_sm(_pio, false);
+    if (sm < 0)
+    {
+        return false;
+    }
+    _sm = sm;
+
+    pio_gpio_init(_pio, pin);
+    pio_sm_set_consecutive_pindirs(_pio, _sm, pin, 1, true);
+
+    pio_sm_config config = pio_get_default_sm_config();
+    sm_config_set_wrap(&config, ws2812Offset, ws2812Offset + ws2812Program.length - 1);
+    sm_config_set_sideset(&config, 1, false, false);
+    sm_config_set_sideset_pins(&config, pin);
+    // Shift out MSB first and pull a new word every 24 bits
+    sm_config_set_out_shift(&config, false, true, 24);
+    sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&config,
+        clock_get_hz(clk_sys) / (float)(PinConstants::LED::BitRateHz * Ws2812CyclesPerBit));
+
+    pio_sm_init(_pio, _sm, ws2812Offset, &config);
+    pio_sm_set_enabled(_pio, _sm, true);
+
+    _dmaChannel = dma_claim_unused_channel(true);
+    _dmaConfig = dma_channel_get_default_config(_dmaChannel);
+    channel_config_set_transfer_data_size(&_dmaConfig, DMA_SIZE_32);
+    channel_config_set_read_increment(&_dmaConfig, true);
+    channel_config_set_write_increment(&_dmaConfig, false);
+    channel_config_set_dreq(&_dmaConfig, pio_get_dreq(_pio, _sm, true));
+
+    return true;
+}
+
+void PioLedTransport::start(const uint32_t *words, uint16_t count)
+{
+    dma_channel_configure(_dmaChannel, &_dmaConfig, &_pio->txf[_sm], words,
+        count, true);
+}
+
+bool PioLedTransport::busy()
+{
+    return dma_channel_is_busy(_dmaChannel);
+}
+
+LedOutput::~LedOutput()
+{
+    delete[] _buffers[0];
+    delete[] _buffers[1];
+}
+
+bool LedOutput::begin(LedTransport *transport, uint8_t pin, CRGB *leds,
+    uint16_t count, const OutputTransform &transform)
+{
+    _transport = transport;
+    _leds = leds;
+    _count = count;
+    _transform = transform;
+
+    // EOrder packs the channel for each wire byte as octal digits
+    _order[0] = (transform.order >> 6) & 0x3;
+    _order[1] = (transform.order >> 3) & 0x3;
+    _order[2] = transform.order & 0x3;
+
+    for (uint16_t value = 0; value < 256; value++)
+    {
+        _gamma[value] = transform.gamma == 1.0f ? value :
+            (uint8_t)(powf(value / 255.0f, transform.gamma) * 255.0f + 0.5f);
+    }
+    _tableBrightness = 256;
+
+    _buffers[0] = new uint32_t[count]();
+    _buffers[1] = new uint32_t[count]();
+
+    _frameTimeUs = (uint32_t)count * PinConstants::LED::PixelTimeUs +
+        PinConstants::LED::ResetTimeUs;
+
+    return _transport->begin(pin);
+}
+
+void LedOutput::show(uint8_t brightness)
+{
+    // The back buffer is never on the wire, so it's always safe to overwrite
+    encode(_buffers[_front ^ 1], brightness);
+
+    if (_pending)
+    {
+        _stats.replaced++;
+    }
+    _pending = true;
+
+    update();
+}
+
+bool LedOutput::update()
+{
+    if (!_pending || _transport->busy())
+    {
+        return false;
+    }
+
+    // DMA finishing only means the FIFO is loaded; wait out the bits and the latch
+    uint32_t now = micros();
+    if (_stats.sent > 0 && now - _lastStartUs < _frameTimeUs)
+    {
+        return false;
+    }
+
+    _front ^= 1;
+    _transport->start(_buffers[_front], _count);
+
+    _pending = false;
+    _lastStartUs = now;
+    _stats.sent++;
+
+    return true;
+}
+
+void LedOutput::buildTables(uint8_t brightness)
+{
+    if (brightness > _transform.maxBrightness)
+    {
+        brightness = _transform.maxBrightness;
+    }
+
+    for (uint8_t slot = 0; slot < 3; slot++)
+    {
+        // CRGB channel 0 is red, which is the top byte of the correction
+        uint8_t correction = _transform.correction >> (8 * (2 - _order[slot]));
+        // Same as FastLED's scale8: (value * (scale + 1)) >> 8
+        uint32_t scale = ((uint32_t)correction + 1) * ((uint32_t)brightness + 1);
+
+        for (uint16_t value = 0; value < 256; value++)
+        {
+            _tables[slot][value] = (_gamma[value] * scale) >> 16;
+        }
+    }
+}
+
+void LedOutput::encode(uint32_t *words, uint8_t brightness)
+{
+    if (brightness != _tableBrightness)
+    {
+        buildTables(brightness);
+        _tableBrightness = brightness;
+    }
+
+    const uint8_t *first = _tables[0];
+    const uint8_t *second = _tables[1];
+    const uint8_t *third = _tables[2];
+
+    for (uint16_t i = 0; i < _count; i++)
+    {
+        const CRGB &pixel = _leds[i];
+
+        words[i] = ((uint32_t)first[pixel.raw[_order[0]]] << 24) |
+            ((uint32_t)second[pixel.raw[_order[1]]] << 16) |
+            ((uint32_t)third[pixel.raw[_order[2]]] << 8);
+    }
+}
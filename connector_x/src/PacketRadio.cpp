@@ -1,8 +1,13 @@
 #include "PacketRadio.h"
 
+#include <pico/stdlib.h>
+
 PacketRadio::PacketRadio(SPIClass *spi, Configuration config,
-                         std::function<void(Message)> newDataCb)
-    : _cb(newDataCb), _config(config) {
+                         std::function<void(const Message *, uint8_t)> newDataCb)
+    : _transfer([this](uint8_t address, const uint8_t *frame, uint8_t len) {
+        _radio->send(address, frame, len);
+      }),
+      _cb(newDataCb), _config(config) {
   _radio = std::make_unique<RFM69_ATC>(Radio::RadioCS, Radio::RadioInterrupt,
                                        true, spi);
 }
@@ -17,37 +22,191 @@ void PacketRadio::init() {
 }
 
 void PacketRadio::update() {
-  if (_radio->receiveDone()) {
-    _lastSenderId = _radio->SENDERID;
-    _lastDataLen = _radio->DATALEN;
-    memcpy(_lastData, _radio->DATA, _lastDataLen);
-    _newDataFlag = true;
-    _radio->sendACK();
+  // The library reads a packet out of the radio in receiveDone() rather than
+  // in its interrupt, so drain it first and leave the slower callback for after
+  while (_radio->receiveDone()) {
+    // Taken first, since the beacon's clock is only as good as this
+    uint64_t receivedUs = time_us_64();
+
+    if (_received.size() == Radio::ReceiveQueueSize) {
+      deliver();
+    }
+
+    if (_radio->ACK_RECEIVED) {
+      if (_sending && _radio->SENDERID == _current.address) {
+        setSendStatus(_current.handle, SendStatus::Sent);
+        _sending = false;
+      }
+    } else if (_beaconCb &&
+               Timebase::isBeacon(_radio->DATA, _radio->DATALEN)) {
+      _beaconCb(_radio->DATA, _radio->DATALEN, receivedUs);
+    } else if (!_transfer.receive(_radio->SENDERID, _radio->DATA,
+                                  _radio->DATALEN, millis())) {
+      receive(_radio->SENDERID, _radio->DATA, _radio->DATALEN);
+    }
+
+    // Acked even if it was a retry, since the sender is retrying because it
+    // never got the last ack. Last, as acking can take in another packet.
+    if (_radio->ACKRequested()) {
+      _radio->sendACK();
+    }
+  }
+
+  deliver();
+  updateSend();
+}
+
+void PacketRadio::updateSend() {
+  uint32_t now = millis();
+  bool ackDue = _sending && now - _sentAtMs >= Radio::AckTimeoutMs;
+
+  if (ackDue && _tries > Radio::SendRetries) {
+    setSendStatus(_current.handle, SendStatus::Failed);
+    _sending = false;
+    ackDue = false;
   }
 
-  if (_newDataFlag && _lastSenderId != 255) {
-    _cb(getLastReceived());
+  bool next = _sending ? ackDue
+                       : !_sendQueue.empty() || _transfer.ready(now);
+
+  // canSend() takes the radio out of receive, so it's only asked when there's
+  // something to send. The library would wait out a busy channel in send().
+  if (!(next || _beaconDue) || !_radio->canSend()) {
+    return;
   }
+
+  if (_beaconDue) {
+    uint8_t beacon[Radio::MaxDataLen];
+    uint8_t len = timebase.writeBeacon(beacon);
+
+    _radio->send(RF69_BROADCAST_ADDR, beacon, len);
+    _beaconDue = false;
+    return;
+  }
+
+  if (!_sending && !_sendQueue.pop(&_current)) {
+    // Messages go first; a transfer sends at most one fragment a pass
+    _transfer.update(now);
+    return;
+  }
+
+  if (!_sending) {
+    setSendStatus(_current.handle, SendStatus::Sending);
+    _tries = 0;
+  }
+
+  bool wantAck = _current.address != RF69_BROADCAST_ADDR;
+  _radio->send(_current.address, _current.frame, _current.len, wantAck);
+  _tries++;
+
+  if (wantAck) {
+    // Same frame and sequence number each try, so retries are dropped as
+    // duplicates if an earlier one did arrive
+    _sending = true;
+    _sentAtMs = millis();
+  } else {
+    setSendStatus(_current.handle, SendStatus::Sent);
+  }
+}
+
+SendStatus PacketRadio::sendStatus(uint16_t handle) const {
+  const SendRecord &record = _sendRecords[handle % Radio::SendStatusSlots];
+  return record.handle == handle ? record.status : SendStatus::Unknown;
+}
+
+void PacketRadio::setSendStatus(uint16_t handle, SendStatus status) {
+  _sendRecords[handle % Radio::SendStatusSlots] = {handle, status};
 }
 
-void PacketRadio::send(Message message) {
-  _radio->send(hashTeamNumber(message.teamNumber), message.data, message.len);
+void PacketRadio::deliver() {
+  Message batch[Radio::ReceiveQueueSize];
+  uint8_t count = 0;
+
+  while (count < Radio::ReceiveQueueSize && _received.pop(&batch[count])) {
+    count++;
+  }
+
+  if (count > 0) {
+    _stats.received += count;
+    _cb(batch, count);
+  }
 }
 
-void PacketRadio::sendToAll(Message message) {
-  _radio->send(255, message.data, message.len);
+void PacketRadio::receive(uint8_t senderId, const uint8_t *data, uint8_t len) {
+  if (len < 2 || data[0] != Radio::MessageMagic) {
+    _stats.unknown++;
+    return;
+  }
+
+  uint8_t sequence = data[1];
+  uint32_t now = millis();
+
+  auto heard = _lastHeard.find(senderId);
+  if (heard == _lastHeard.end() ||
+      now - heard->second.atMs >= Radio::DuplicateWindowMs) {
+    // New, or quiet long enough that it may have restarted its count
+    _lastHeard[senderId] = {sequence, 1, now};
+  } else {
+    LastHeard &last = heard->second;
+    int8_t ahead = (int8_t)(sequence - last.newest);
+
+    if (ahead > 0) {
+      last.heard = ahead < 32 ? (last.heard << ahead) | 1 : 1;
+      last.newest = sequence;
+    } else if (-ahead >= 32 || (last.heard & (1u << -ahead))) {
+      _stats.duplicates++;
+      return;
+    } else {
+      last.heard |= 1u << -ahead;
+    }
+
+    last.atMs = now;
+  }
+
+  Message *msg = _received.claim();
+  if (!msg) {
+    _stats.overflows++;
+    return;
+  }
+
+  msg->len = len - 2;
+  memcpy(msg->data, &data[2], msg->len);
+  msg->teamNumber = getTeamBySenderId(senderId);
+  _received.publish();
 }
 
-Message PacketRadio::getLastReceived() {
-  if (_lastSenderId != 255) {
-    Message msg;
-    memcpy(msg.data, _lastData, _lastDataLen);
-    msg.len = _lastDataLen;
-    msg.teamNumber = getTeamBySenderId(_lastSenderId);
+uint8_t PacketRadio::writeFrame(uint8_t *buf, uint8_t sequence,
+                                const Message &message) {
+  uint8_t len = message.len < Radio::MaxMessageLen ? message.len
+                                                   : Radio::MaxMessageLen;
+
+  buf[0] = Radio::MessageMagic;
+  buf[1] = sequence;
+  memcpy(&buf[2], message.data, len);
 
-    return msg;
+  return len + 2;
+}
+
+void PacketRadio::queueSend(uint8_t address, const Message &message,
+                            uint16_t handle) {
+  PendingSend *pending = _sendQueue.claim();
+  if (!pending) {
+    setSendStatus(handle, SendStatus::Failed);
+    return;
   }
 
-  Message msg;
-  return msg;
-}
\ No newline at end of file
+  pending->handle = handle;
+  pending->address = address;
+  pending->len = writeFrame(pending->frame, _sequence++, message);
+  _sendQueue.publish();
+
+  setSendStatus(handle, SendStatus::Queued);
+}
+
+void PacketRadio::send(Message message, uint16_t handle) {
+  queueSend(hashTeamNumber(message.teamNumber), message, handle);
+}
+
+void PacketRadio::sendToAll(Message message, uint16_t handle) {
+  queueSend(RF69_BROADCAST_ADDR, message, handle);
+}
@@ -0,0 +1,545 @@
+#include "PatternBenchmark.h"
+
+#include "Configuration.h"
+#include "PatternVm.h"
+#include "PatternZone.h"
+#include "Patterns.h"
+#include "RenderScheduler.h"
+#include "Wave.h"
+#include "ZoneView.h"
+
+#ifndef ARDUINO_ARCH_RP2040
+#include <Native.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif
+
+namespace
+{
+    const uint16_t ledCounts[] = {18, 93, 256, 1000, 4000};
+
+    // The strip and the matrix from Configuration.h
+    const uint16_t frameLedCounts[] = {
+        configuration.led0.strip.count,
+        (uint16_t)(configuration.led1.matrix.width * configuration.led1.matrix.height),
+    };
+
+    // Frames timed per pattern and path, whatever the pattern's state count
+    constexpr uint32_t framesTimed = 2000;
+
+    // SineRoll at its default speed and wavelength, so the rows for empty
+    // program slots show what the VM costs over the native pattern
+    const uint8_t sineRollProgram[] = {
+        (uint8_t)ProgramOp::Index,
+        (uint8_t)ProgramOp::Push16, 0xcc, 0x0c, // 65536 / 20
+        (uint8_t)ProgramOp::Mul,
+        (uint8_t)ProgramOp::State,
+        (uint8_t)ProgramOp::Push16, 0x00, 0x04, // 4 / 256 of a cycle
+        (uint8_t)ProgramOp::Mul,
+        (uint8_t)ProgramOp::Sub,
+        (uint8_t)ProgramOp::Sin,
+        (uint8_t)ProgramOp::Shade,
+        (uint8_t)ProgramOp::End,
+    };
+
+    inline uint64_t now()
+    {
+#ifdef ARDUINO_ARCH_RP2040
+        return rp2040.getCycleCount64();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    inline uint64_t toNs(uint64_t ticks)
+    {
+#ifdef ARDUINO_ARCH_RP2040
+        return ticks * 1000000000ull / F_CPU;
+#else
+        return ticks;
+#endif
+    }
+
+    struct GenericKernel
+    {
+        PatternType type;
+        ExecutePatternCallback<ZoneView> cb;
+    };
+
+    // The LED loop patterns built for a plain ZoneView, which works out the
+    // zone's direction on every pixel the way every pattern used to, to
+    // show what the registry's fixed-direction builds save
+    const GenericKernel genericKernels[] = {
+        {PatternType::SetAll, Animation::executePatternSetAll<ZoneView>},
+        {PatternType::RGBFade, Animation::executePatternRGBFade<ZoneView>},
+        {PatternType::Breathing, Animation::executePatternBreathing<ZoneView>},
+        {PatternType::SineRoll, Animation::executePatternSineRoll<ZoneView>},
+        {PatternType::Chase, Animation::executePatternChase<ZoneView>},
+    };
+
+    // SineRoll as it was before the wave engine: a soft-float sin and two
+    // double products per LED, with its old 20 LED wavelength and 60 states
+    bool sineRollDouble(const ZoneView &strip, uint32_t color, uint16_t state,
+        uint16_t ledCount)
+    {
+        constexpr double width = 10;
+        constexpr uint8_t states = 60;
+
+        for (uint16_t index = 0; index < ledCount; index++)
+        {
+            double t1 = (2 * M_PI / states) * (states - state % states);
+            double t2 = (1 / width) * M_PI * index;
+            double brightness = sin(t2 + t1) + 1;
+            uint8_t quantizedBrightness = 255 * (brightness / 2);
+            setColorScaled(strip, index, color, quantizedBrightness);
+        }
+
+        return true;
+    }
+
+    // The VM dispatching through a table of handlers, one indirect call per
+    // instruction, instead of PatternVm::run's switch. Only has the
+    // instructions sineRollProgram uses.
+    struct TableVm
+    {
+        int32_t stack[Animation::programStackDepth];
+        int32_t *top;
+        const uint8_t *pc;
+        const PatternVm::Inputs *inputs;
+        bool done;
+    };
+
+    typedef void (*OpHandler)(TableVm &vm);
+
+    const OpHandler opHandlers[] = {
+        // End
+        [](TableVm &vm) { vm.done = true; },
+        nullptr,
+        // Push16
+        [](TableVm &vm) { *++vm.top = (int16_t)(vm.pc[0] | (vm.pc[1] << 8)); vm.pc += 2; },
+        // Index
+        [](TableVm &vm) { *++vm.top = vm.inputs->index; },
+        nullptr,
+        // State
+        [](TableVm &vm) { *++vm.top = vm.inputs->state; },
+        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+        // Sub
+        [](TableVm &vm) { int32_t b = *vm.top--; *vm.top = (int32_t)((uint32_t)*vm.top - b); },
+        // Mul
+        [](TableVm &vm) { int32_t b = *vm.top--; *vm.top = (int32_t)((uint32_t)*vm.top * b); },
+        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+        nullptr, nullptr, nullptr, nullptr, nullptr,
+        // Sin
+        [](TableVm &vm) { *vm.top = Wave::toBrightness(Wave::sine((uint16_t)*vm.top)); },
+        nullptr, nullptr,
+        // Shade
+        [](TableVm &vm)
+        {
+            uint32_t color = vm.inputs->color;
+            uint8_t scaling = *vm.top < 0 ? 0 : *vm.top > 255 ? 255 : *vm.top;
+            *vm.top = ((((color >> 16) & 0xff) * scaling >> 8) << 16) |
+                ((((color >> 8) & 0xff) * scaling >> 8) << 8) |
+                ((color & 0xff) * scaling >> 8);
+        },
+    };
+
+    static_assert(sizeof(opHandlers) / sizeof(opHandlers[0]) == (uint8_t)ProgramOp::Shade + 1,
+        "opHandlers must be indexed by ProgramOp");
+
+    // Same inputs as PatternVm::render
+    bool sineRollTable(const ZoneView &strip, uint32_t color, uint16_t state,
+        uint16_t ledCount)
+    {
+        PatternVm::Inputs inputs = {
+            .index = 0,
+            .count = ledCount,
+            .state = state,
+            .timeMs = (int32_t)timebase.nowMs(),
+            .color = color,
+        };
+
+        TableVm vm;
+        vm.inputs = &inputs;
+
+        for (uint16_t i = 0; i < ledCount; i++)
+        {
+            inputs.index = i;
+            vm.top = vm.stack - 1;
+            vm.pc = sineRollProgram;
+            vm.done = false;
+
+            while (!vm.done)
+            {
+                opHandlers[*vm.pc++](vm);
+            }
+
+            strip[i] = *vm.top;
+        }
+
+        return true;
+    }
+
+    uint32_t stateCount(PatternType type, uint16_t ledCount)
+    {
+        auto &pattern = Animation::patterns[(uint8_t)type];
+
+        uint32_t states = pattern.numStates;
+        if (pattern.mode == PatternStateMode::LedCount)
+        {
+            states += ledCount;
+        }
+
+        return std::max<uint32_t>(states, 1);
+    }
+
+    /**
+     * @brief Run render through every state and print the row
+     */
+    template <typename Render>
+    void timeCycle(Stream &out, PatternType type, const char *direction,
+        uint32_t states, uint16_t ledCount, bool reversed, Render render)
+    {
+        CRGB *leds = new CRGB[ledCount]();
+        ZoneView strip(leds, 0, ledCount, reversed);
+
+        uint64_t totalNs = 0;
+        uint64_t worstNs = 0;
+
+        for (uint32_t state = 0; state < states; state++)
+        {
+            uint64_t start = now();
+            render(strip, state, ledCount);
+            uint64_t elapsed = toNs(now() - start);
+
+            totalNs += elapsed;
+            worstNs = std::max(worstNs, elapsed);
+        }
+
+        delete[] leds;
+
+        out.printf("%u,%u,%s,%lu,%.2f,%.2f\n", (uint8_t)type, ledCount, direction,
+            (unsigned long)states, (double)totalNs / ((uint64_t)states * ledCount),
+            worstNs / 1000.0);
+    }
+
+    /**
+     * @brief Time whole zone frames of a pattern as PatternZone draws them
+     * now, straight into the port buffer, and as it used to: into a scratch
+     * buffer allocated for the frame, then copied into the port
+     */
+    void timeFrames(Stream &out, const Pattern &pattern, uint16_t ledCount, bool reversed)
+    {
+        // The zone sits in the middle of a port, as zones usually do
+        uint16_t offset = 8;
+        CRGB *port = new CRGB[ledCount + 2 * offset]();
+        ZoneView view(port, offset, ledCount, reversed);
+        uint32_t states = std::min(stateCount(pattern.type, ledCount), framesTimed);
+
+        for (bool scratch : {false, true})
+        {
+            uint64_t totalNs = 0;
+            uint64_t worstNs = 0;
+
+            for (uint32_t frame = 0; frame < framesTimed; frame++)
+            {
+                uint16_t state = frame % states;
+                uint64_t start = now();
+
+                if (scratch)
+                {
+                    CRGB *pixels = new CRGB[ledCount];
+                    memset((void *)pixels, 0, sizeof(CRGB) * ledCount);
+                    pattern.render(ZoneView(pixels, ledCount), 0xFFFFFF, state, ledCount);
+
+                    for (uint16_t pixel = 0; pixel < ledCount; pixel++)
+                    {
+                        view[pixel] = pixels[pixel];
+                    }
+                    delete[] pixels;
+                }
+                else
+                {
+                    view.clear();
+                    pattern.render(view, 0xFFFFFF, state, ledCount);
+                }
+
+                uint64_t elapsed = toNs(now() - start);
+                totalNs += elapsed;
+                worstNs = std::max(worstNs, elapsed);
+            }
+
+            out.printf("%u,%u,%s,%s,%.2f,%.2f\n", (uint8_t)pattern.type, ledCount,
+                reversed ? "reversed" : "forward", scratch ? "scratch" : "in_place",
+                totalNs / 1000.0 / framesTimed, worstNs / 1000.0);
+        }
+
+        delete[] port;
+    }
+
+    // One zone per port for timeCores, as the strip and the matrix in Configuration.h
+    PatternZone *coreZones[PinConstants::LED::NumPorts];
+
+    void renderCoreZone(uint8_t job)
+    {
+        coreZones[job]->updateZone(0, true);
+    }
+
+    /**
+     * @brief Time frames of the strip and the matrix, both running the
+     * SineRoll program, shared out by RenderScheduler as loop1() does: first
+     * with core1 rendering alone, then with a second thread taking jobs the
+     * way core0 does between I2C writes. The board's benchmark runs with
+     * core1 idled, so it only has the one core row.
+     */
+    void timeCores(Stream &out)
+    {
+        RenderScheduler<PinConstants::LED::NumPorts> scheduler(renderCoreZone);
+        CRGB *leds[PinConstants::LED::NumPorts];
+        uint32_t ledTotal = 0;
+
+        for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
+        {
+            uint16_t count = frameLedCounts[port % 2];
+            leds[port] = new CRGB[count]();
+            coreZones[port] = new PatternZone(port, 255, leds[port], count);
+            coreZones[port]->setRunZone(0, false);
+            coreZones[port]->setPattern(PatternType::Program0, 0);
+            ledTotal += count;
+        }
+
+#ifdef ARDUINO_ARCH_RP2040
+        const uint8_t maxCores = 1;
+        const uint32_t cpus = 2;
+#else
+        const uint8_t maxCores = 2;
+        const uint32_t cpus = std::thread::hardware_concurrency();
+#endif
+
+        double oneCoreUs = 0;
+
+        for (uint8_t cores = 1; cores <= maxCores; cores++)
+        {
+#ifndef ARDUINO_ARCH_RP2040
+            std::atomic<bool> running{true};
+            std::thread core0;
+            if (cores == 2)
+            {
+                core0 = std::thread([&scheduler, &running]()
+                {
+                    Native::setCoreNum(0);
+                    while (running.load(std::memory_order_relaxed))
+                    {
+                        if (!scheduler.runOne())
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+            }
+#endif
+
+            uint64_t totalNs = 0;
+            uint64_t worstNs = 0;
+
+            for (uint32_t frame = 0; frame < framesTimed; frame++)
+            {
+                uint64_t start = now();
+                scheduler.open();
+                scheduler.finish();
+                uint64_t elapsed = toNs(now() - start);
+
+                totalNs += elapsed;
+                worstNs = std::max(worstNs, elapsed);
+            }
+
+#ifndef ARDUINO_ARCH_RP2040
+            running = false;
+            if (core0.joinable())
+            {
+                core0.join();
+            }
+#endif
+
+            double avgUs = totalNs / 1000.0 / framesTimed;
+            if (cores == 1)
+            {
+                oneCoreUs = avgUs;
+            }
+
+            out.printf("%u,%lu,%lu,%.2f,%.2f,%.2f\n", cores, (unsigned long)cpus,
+                (unsigned long)ledTotal, avgUs, oneCoreUs / avgUs, worstNs / 1000.0);
+        }
+
+        for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
+        {
+            delete coreZones[port];
+            delete[] leds[port];
+        }
+    }
+
+    /**
+     * @brief Time a zone running SineRoll under layers - 1 overlays, each
+     * Breathing blended on with the given mode, through PatternZone so the
+     * compositing pass is included
+     */
+    void timeLayers(Stream &out, uint8_t layers, uint16_t ledCount, BlendMode blend,
+        const char *blendName)
+    {
+        CRGB *leds = new CRGB[ledCount]();
+        PatternZone zone(0, 255, leds, ledCount);
+
+        zone.setRunZone(0, false);
+        zone.setPattern(PatternType::SineRoll, 5);
+        for (uint8_t layer = 1; layer < layers; layer++)
+        {
+            zone.setLayer(layer, 128, blend);
+            zone.setPattern(PatternType::Breathing, 10);
+        }
+
+        uint64_t totalNs = 0;
+        uint64_t worstNs = 0;
+
+        for (uint32_t frame = 0; frame < framesTimed; frame++)
+        {
+            uint64_t start = now();
+            zone.updateZone(0, true);
+            uint64_t elapsed = toNs(now() - start);
+
+            totalNs += elapsed;
+            worstNs = std::max(worstNs, elapsed);
+        }
+
+        delete[] leds;
+
+        out.printf("%u,%u,%s,%.2f,%.2f,%.2f\n", layers, ledCount, blendName,
+            totalNs / 1000.0 / framesTimed, (double)totalNs / ((uint64_t)framesTimed * ledCount),
+            worstNs / 1000.0);
+    }
+}
+
+void PatternBenchmark::run(Stream &out)
+{
+    out.printf("pattern,leds,direction,states,ns_per_led,worst_frame_us\n");
+
+    bool borrowed[Animation::programSlots] = {};
+    for (uint8_t slot = 0; slot < Animation::programSlots; slot++)
+    {
+        if (!programs[slot].loaded())
+        {
+            borrowed[slot] = programs[slot].load(sineRollProgram, sizeof(sineRollProgram));
+        }
+    }
+
+    for (auto &pattern : Animation::patterns)
+    {
+        for (uint16_t ledCount : ledCounts)
+        {
+            for (bool reversed : {false, true})
+            {
+                timeCycle(out, pattern.type, reversed ? "reversed" : "forward",
+                    stateCount(pattern.type, ledCount), ledCount, reversed,
+                    [&pattern](const ZoneView &strip, uint16_t state, uint16_t count)
+                    {
+                        return pattern.render(strip, 0xFFFFFF, state, count);
+                    });
+            }
+        }
+    }
+
+    for (auto &kernel : genericKernels)
+    {
+        for (uint16_t ledCount : ledCounts)
+        {
+            for (bool reversed : {false, true})
+            {
+                timeCycle(out, kernel.type,
+                    reversed ? "generic_reversed" : "generic_forward",
+                    stateCount(kernel.type, ledCount), ledCount, reversed,
+                    [&kernel](const ZoneView &strip, uint16_t state, uint16_t count)
+                    {
+                        return kernel.cb(strip, 0xFFFFFF, state, count);
+                    });
+            }
+        }
+    }
+
+    for (uint16_t ledCount : ledCounts)
+    {
+        for (bool reversed : {false, true})
+        {
+            timeCycle(out, PatternType::SineRoll,
+                reversed ? "double_reversed" : "double_forward",
+                stateCount(PatternType::SineRoll, ledCount), ledCount, reversed,
+                [](const ZoneView &strip, uint16_t state, uint16_t count)
+                {
+                    return sineRollDouble(strip, 0xFFFFFF, state, count);
+                });
+        }
+    }
+
+    for (uint16_t ledCount : ledCounts)
+    {
+        for (bool reversed : {false, true})
+        {
+            timeCycle(out, PatternType::Program0,
+                reversed ? "table_reversed" : "table_forward",
+                stateCount(PatternType::Program0, ledCount), ledCount, reversed,
+                [](const ZoneView &strip, uint16_t state, uint16_t count)
+                {
+                    return sineRollTable(strip, 0xFFFFFF, state, count);
+                });
+        }
+    }
+
+    out.printf("\npattern,leds,direction,path,avg_frame_us,worst_frame_us\n");
+
+    for (auto &pattern : Animation::patterns)
+    {
+        for (uint16_t ledCount : frameLedCounts)
+        {
+            for (bool reversed : {false, true})
+            {
+                timeFrames(out, pattern, ledCount, reversed);
+            }
+        }
+    }
+
+    out.printf("\nlayers,leds,blend,avg_frame_us,ns_per_led,worst_frame_us\n");
+
+    const struct
+    {
+        BlendMode mode;
+        const char *name;
+    } blends[] = {
+        {BlendMode::Normal, "normal"},
+        {BlendMode::Add, "add"},
+        {BlendMode::Max, "max"},
+        {BlendMode::Multiply, "multiply"},
+        {BlendMode::Screen, "screen"},
+    };
+
+    for (auto &blend : blends)
+    {
+        for (uint16_t ledCount : {(uint16_t)93, (uint16_t)256, (uint16_t)1000})
+        {
+            for (uint8_t layers = 1; layers <= Animation::maxZoneLayers; layers++)
+            {
+                timeLayers(out, layers, ledCount, blend.mode, blend.name);
+            }
+        }
+    }
+
+    out.printf("\ncores,cpus,leds,avg_frame_us,speedup,worst_frame_us\n");
+    timeCores(out);
+
+    for (uint8_t slot = 0; slot < Animation::programSlots; slot++)
+    {
+        if (borrowed[slot])
+        {
+            programs[slot].clear();
+        }
+    }
+}
@@ -0,0 +1,338 @@
+#include "PatternVm.h"
+
+#include <LittleFS.h>
+
+#include "Wave.h"
+
+PatternVm programs[Animation::programSlots];
+
+namespace
+{
+    struct OpInfo
+    {
+        uint8_t pops;
+        uint8_t pushes;
+        uint8_t immediateBytes;
+    };
+
+    // Indexed by ProgramOp
+    const OpInfo opInfo[] = {
+        {1, 0, 0}, // End
+        {0, 1, 1}, // Push8
+        {0, 1, 2}, // Push16
+        {0, 1, 0}, // Index
+        {0, 1, 0}, // Count
+        {0, 1, 0}, // State
+        {0, 1, 0}, // TimeMs
+        {0, 1, 0}, // Red
+        {0, 1, 0}, // Green
+        {0, 1, 0}, // Blue
+        {1, 2, 0}, // Dup
+        {1, 0, 0}, // Drop
+        {2, 2, 0}, // Swap
+        {2, 3, 0}, // Over
+        {2, 1, 0}, // Add
+        {2, 1, 0}, // Sub
+        {2, 1, 0}, // Mul
+        {2, 1, 0}, // Div
+        {2, 1, 0}, // Mod
+        {2, 1, 0}, // Scale
+        {2, 1, 0}, // Shl
+        {2, 1, 0}, // Shr
+        {2, 1, 0}, // And
+        {2, 1, 0}, // Or
+        {2, 1, 0}, // Xor
+        {2, 1, 0}, // Min
+        {2, 1, 0}, // Max
+        {2, 1, 0}, // Lt
+        {2, 1, 0}, // Gt
+        {2, 1, 0}, // Eq
+        {3, 1, 0}, // Select
+        {1, 1, 0}, // Sin
+        {1, 1, 0}, // Tri
+        {3, 1, 0}, // Rgb
+        {1, 1, 0}, // Shade
+    };
+
+    constexpr uint8_t OpCount = sizeof(opInfo) / sizeof(opInfo[0]);
+    static_assert(OpCount == (uint8_t)ProgramOp::Shade + 1, "opInfo must cover every ProgramOp");
+
+    inline uint8_t clampChannel(int32_t value)
+    {
+        return value < 0 ? 0 : value > 255 ? 255 : value;
+    }
+
+    inline int32_t wrap(uint32_t value)
+    {
+        return (int32_t)value;
+    }
+}
+
+bool PatternVm::validate(const uint8_t *code, uint16_t length)
+{
+    uint8_t depth = 0;
+
+    for (uint16_t pos = 0; pos < length; )
+    {
+        uint8_t op = code[pos];
+        if (op >= OpCount)
+        {
+            return false;
+        }
+
+        const OpInfo &info = opInfo[op];
+        if (pos + 1 + info.immediateBytes > length || depth < info.pops)
+        {
+            return false;
+        }
+
+        if ((ProgramOp)op == ProgramOp::End)
+        {
+            // The color must be the only thing left, and nothing may follow
+            return depth == 1 && pos + 1 == length;
+        }
+
+        depth = depth - info.pops + info.pushes;
+        if (depth > Animation::programStackDepth)
+        {
+            return false;
+        }
+
+        pos += 1 + info.immediateBytes;
+    }
+
+    return false;
+}
+
+bool PatternVm::load(const uint8_t *code, uint16_t length)
+{
+    if (length > Animation::programMaxSize || !validate(code, length))
+    {
+        return false;
+    }
+
+    memcpy(_code, code, length);
+    _length = length;
+
+    return true;
+}
+
+bool PatternVm::loadFile(const char *path)
+{
+    File file = LittleFS.open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    uint8_t code[Animation::programMaxSize];
+    size_t length = file.size();
+    bool valid = length <= sizeof(code) &&
+        file.readBytes((char *)code, length) == length;
+
+    file.close();
+
+    return valid && load(code, length);
+}
+
+bool PatternVm::write(uint16_t offset, const uint8_t *bytes, uint8_t length, bool last)
+{
+    if (offset + length > Animation::programMaxSize)
+    {
+        return false;
+    }
+
+    memcpy(&_staging[offset], bytes, length);
+
+    return last ? load(_staging, offset + length) : true;
+}
+
+uint32_t PatternVm::run(const Inputs &inputs) const
+{
+    int32_t stack[Animation::programStackDepth];
+    // Points at the top value; validate() guarantees it never leaves the stack
+    int32_t *top = stack - 1;
+    const uint8_t *pc = _code;
+    int32_t a, b;
+
+    for (;;)
+    {
+        switch ((ProgramOp)*pc++)
+        {
+        case ProgramOp::End:
+            return *top;
+
+        case ProgramOp::Push8:
+            *++top = *pc++;
+            break;
+
+        case ProgramOp::Push16:
+            *++top = (int16_t)(pc[0] | (pc[1] << 8));
+            pc += 2;
+            break;
+
+        case ProgramOp::Index:
+            *++top = inputs.index;
+            break;
+
+        case ProgramOp::Count:
+            *++top = inputs.count;
+            break;
+
+        case ProgramOp::State:
+            *++top = inputs.state;
+            break;
+
+        case ProgramOp::TimeMs:
+            *++top = inputs.timeMs;
+            break;
+
+        case ProgramOp::Red:
+            *++top = (inputs.color >> 16) & 0xff;
+            break;
+
+        case ProgramOp::Green:
+            *++top = (inputs.color >> 8) & 0xff;
+            break;
+
+        case ProgramOp::Blue:
+            *++top = inputs.color & 0xff;
+            break;
+
+        case ProgramOp::Dup:
+            top[1] = top[0];
+            top++;
+            break;
+
+        case ProgramOp::Drop:
+            top--;
+            break;
+
+        case ProgramOp::Swap:
+            a = top[-1];
+            top[-1] = top[0];
+            top[0] = a;
+            break;
+
+        case ProgramOp::Over:
+            top[1] = top[-1];
+            top++;
+            break;
+
+        case ProgramOp::Add:
+            b = *top--;
+            *top = wrap((uint32_t)*top + b);
+            break;
+
+        case ProgramOp::Sub:
+            b = *top--;
+            *top = wrap((uint32_t)*top - b);
+            break;
+
+        case ProgramOp::Mul:
+            b = *top--;
+            *top = wrap((uint32_t)*top * b);
+            break;
+
+        case ProgramOp::Div:
+            b = *top--;
+            *top = b == 0 ? 0 : b == -1 ? wrap(0u - *top) : *top / b;
+            break;
+
+        case ProgramOp::Mod:
+            b = *top--;
+            *top = b == 0 || b == -1 ? 0 : *top % b;
+            break;
+
+        case ProgramOp::Scale:
+            b = *top--;
+            *top = wrap((uint32_t)*top * b) >> 8;
+            break;
+
+        case ProgramOp::Shl:
+            b = *top--;
+            *top = wrap((uint32_t)*top << (b & 31));
+            break;
+
+        case ProgramOp::Shr:
+            b = *top--;
+            *top = *top >> (b & 31);
+            break;
+
+        case ProgramOp::And:
+            b = *top--;
+            *top &= b;
+            break;
+
+        case ProgramOp::Or:
+            b = *top--;
+            *top |= b;
+            break;
+
+        case ProgramOp::Xor:
+            b = *top--;
+            *top ^= b;
+            break;
+
+        case ProgramOp::Min:
+            b = *top--;
+            *top = *top < b ? *top : b;
+            break;
+
+        case ProgramOp::Max:
+            b = *top--;
+            *top = *top > b ? *top : b;
+            break;
+
+        case ProgramOp::Lt:
+            b = *top--;
+            *top = *top < b;
+            break;
+
+        case ProgramOp::Gt:
+            b = *top--;
+            *top = *top > b;
+            break;
+
+        case ProgramOp::Eq:
+            b = *top--;
+            *top = *top == b;
+            break;
+
+        case ProgramOp::Select:
+            b = *top--;
+            a = *top--;
+            *top = *top ? a : b;
+            break;
+
+        case ProgramOp::Sin:
+            *top = Wave::toBrightness(Wave::sine((uint16_t)*top));
+            break;
+
+        case ProgramOp::Tri:
+            *top = Wave::toBrightness(Wave::triangle((uint16_t)*top));
+            break;
+
+        case ProgramOp::Rgb:
+            b = *top--;
+            a = *top--;
+            *top = ((uint32_t)clampChannel(*top) << 16) | (clampChannel(a) << 8) |
+                clampChannel(b);
+            break;
+
+        case ProgramOp::Shade:
+        {
+            uint8_t scaling = clampChannel(*top);
+            // Same scaling as setColorScaled
+            *top = ((((inputs.color >> 16) & 0xff) * scaling >> 8) << 16) |
+                ((((inputs.color >> 8) & 0xff) * scaling >> 8) << 8) |
+                ((inputs.color & 0xff) * scaling >> 8);
+            break;
+        }
+
+        default:
+            // Unreachable for a validated program
+            return 0;
+        }
+    }
+}
@@ -1,12 +1,19 @@
 #include "PatternZone.h"
 
+#include "LedOutput.h"
+#include "Stats.h"
+
 PatternZone::PatternZone(uint8_t port, uint8_t brightness,
-            CRGB *leds, uint16_t ledCount, uint16_t zoneCount)
+            CRGB *leds, uint16_t ledCount, uint16_t zoneCount,
+            uint16_t maxFrameRate)
     : _leds(leds), _port(port), _brightness(brightness)
 {
+    setMaxFrameRate(maxFrameRate);
+
     uint16_t ledCountPerLength = ledCount / zoneCount;
     _zones = std::make_unique<std::vector<ZoneDefinition>>();
     _runZones = std::make_unique<std::vector<RunZone>>();
+    _layers = std::make_unique<std::vector<ZoneLayers>>();
 
     for (uint16_t i = 0; i < zoneCount; i++)
     {
@@ -14,6 +21,7 @@ PatternZone::PatternZone(uint8_t port, uint8_t brightness,
 
         _zones->push_back(ZoneDefinition(offset, ledCountPerLength ));
         _runZones->push_back(RunZone(i, false));
+        _layers->push_back(ZoneLayers());
     }
 
     // Serial.printf("Zone size=%d\r\n", _zones->size());
@@ -24,20 +32,25 @@ PatternZone::PatternZone(uint8_t port, uint8_t brightness,
 }
 
 PatternZone::PatternZone(uint8_t port, uint8_t brightness,
-            CRGB *leds, std::vector<ZoneDefinition> *zones)
+            CRGB *leds, std::vector<ZoneDefinition> *zones,
+            uint16_t maxFrameRate)
     : _leds(leds), _port(port), _brightness(brightness)
 {
+    setMaxFrameRate(maxFrameRate);
+
     _zones.reset(zones);
     for (uint8_t i = 0; i < _zones->size(); i++)
     {
         Serial.printf("Zone: %s\r\n", _zones->at(i).toString().c_str());
     }
     _runZones = std::make_unique<std::vector<RunZone>>();
+    _layers = std::make_unique<std::vector<ZoneLayers>>();
 
     // Serial.printf("Zone size=%d\r\n", _zones->size());
     for (uint16_t i = 0; i < _zones->size(); i++)
     {
         _runZones->push_back(RunZone(i, false));
+        _layers->push_back(ZoneLayers());
     }
 }
 
@@ -52,44 +65,84 @@ bool PatternZone::setRunZone(uint16_t index, bool reversed)
     runZone.reversed = reversed;
 
     _zoneIndex = index;
+    _layerIndex = 0;
     return true;
 }
 
-bool PatternZone::runPattern(uint16_t index, Pattern *pattern, CRGB* pixels,
-            uint32_t color, uint16_t state)
+bool PatternZone::setLayer(uint8_t layer, uint8_t alpha, BlendMode blend)
 {
-    auto& curZoneDef = getZoneDefinitionFromIndex(index);
-    auto& runZone = getRunZoneFromIndex(index);
-
-    // Serial.printf("Creating %d temp LED array\r\n", curZoneDef.count);
-
-    CRGB *tempLeds = new CRGB[curZoneDef.count];
-    memset(tempLeds, 0, sizeof(CRGB) * curZoneDef.count);
-
-    // Serial.printf("Created %d temp LED array\r\n", curZoneDef.count);
-    // Serial.printf("Color=%lu, state=%u\r\n", runZone.color, runZone.state);
-    bool shouldShow = pattern->cb(tempLeds, runZone.color, runZone.state, curZoneDef.count);
-    // Serial.printf("Should show=%u\r\n", shouldShow);
+    if (layer >= Animation::maxZoneLayers)
+    {
+        return false;
+    }
 
-    // Serial.printf("First pixel=%lu\r\n", (uint32_t)tempLeds[0]);
+    auto& curZoneDef = getZoneDefinitionFromIndex(_zoneIndex);
+    auto& layers = getLayersFromIndex(_zoneIndex);
 
-    if (runZone.reversed)
+    if (layer > 0 && !layers.base)
     {
+        // The base has been drawing straight into the port, so keep what it last drew
+        ZoneView view(_leds, curZoneDef.offset, curZoneDef.count,
+            getRunZoneFromIndex(_zoneIndex).reversed);
+        layers.base.reset(new CRGB[curZoneDef.count]);
+
         for (uint16_t pixel = 0; pixel < curZoneDef.count; pixel++)
         {
-            _leds[(curZoneDef.count - pixel) + curZoneDef.offset] = tempLeds[pixel];
+            layers.base[pixel] = view[pixel];
         }
     }
-    else
+
+    while (layers.overlays.size() < layer)
     {
-        for (uint16_t pixel = 0; pixel < curZoneDef.count; pixel++)
-        {
-            // Serial.printf("Mapping temp led=%d to led=%d color=%X\r\n", pixel, pixel + curZoneDef.offset, (uint32_t)tempLeds[pixel]);
-            _leds[pixel + curZoneDef.offset] = tempLeds[pixel];
-        }
+        OverlayLayer overlay;
+        overlay.run = RunZone(_zoneIndex, false);
+        overlay.alpha = 255;
+        overlay.blend = BlendMode::Normal;
+        overlay.pixels.reset(new CRGB[curZoneDef.count]());
+        layers.overlays.push_back(std::move(overlay));
     }
 
-    delete[] tempLeds;
+    if (layer > 0)
+    {
+        auto& overlay = layers.overlays.at(layer - 1);
+        overlay.alpha = alpha;
+        overlay.blend = blend;
+    }
+
+    _layerIndex = layer;
+    return true;
+}
+
+ZoneView PatternZone::getLayerTarget(uint16_t index, uint8_t layer)
+{
+    auto& curZoneDef = getZoneDefinitionFromIndex(index);
+    auto& layers = getLayersFromIndex(index);
+
+    if (layers.overlays.empty())
+    {
+        // Render straight into the port buffer; reversed zones are handled by the view
+        return ZoneView(_leds, curZoneDef.offset, curZoneDef.count,
+            getRunZoneFromIndex(index).reversed);
+    }
+
+    CRGB *pixels = layer == 0 ?
+        layers.base.get() :
+        layers.overlays.at(layer - 1).pixels.get();
+
+    return ZoneView(pixels, curZoneDef.count);
+}
+
+bool PatternZone::runPattern(uint16_t index, uint8_t layer, const Pattern *pattern)
+{
+    auto& curZoneDef = getZoneDefinitionFromIndex(index);
+    auto& runZone = getLayerRunZone(index, layer);
+
+    ZoneView view = getLayerTarget(index, layer);
+    view.clear();
+
+    // Serial.printf("Color=%lu, state=%u\r\n", runZone.color, runZone.state);
+    bool shouldShow = pattern->render(view, runZone.color, runZone.state, curZoneDef.count);
+    // Serial.printf("Should show=%u\r\n", shouldShow);
 
     return shouldShow;
 }
@@ -101,58 +154,279 @@ void PatternZone::updateZones(bool forceUpdate)
     {
         updateZone(zone, forceUpdate);
     }
+
+    flush();
 }
 
 void PatternZone::updateZone(uint16_t index, bool forceUpdate)
 {
-    RunZone& runZone = getRunZoneFromIndex(index);
-    auto& curZoneDef = getZoneDefinitionFromIndex(index);
+    bool changed = false;
+    uint8_t layerCount = getLayersFromIndex(index).overlays.size() + 1;
+    uint32_t startUs = StatTimer::start();
+
+    for (uint8_t layer = 0; layer < layerCount; layer++)
+    {
+        changed |= updateLayer(index, layer, forceUpdate);
+    }
+
+    if (changed)
+    {
+        present(index);
+        localPortStats(_port).render.stop(startUs);
+    }
+}
+
+bool PatternZone::updateLayer(uint16_t index, uint8_t layer, bool forceUpdate)
+{
+    RunZone& runZone = getLayerRunZone(index, layer);
     auto curPattern = getPattern(runZone.patternIndex);
 
+    if (layer > 0 && curPattern->type == PatternType::None && !forceUpdate)
+    {
+        // Draws nothing and composite skips it, so there's nothing to run
+        return false;
+    }
+
     // Serial.printf("Updating zone index=%u, state=%d, patternIndex=%d\r\n",
     //     index, runZone.state, runZone.patternIndex);
 
+    if (runZone.timed && runZone.delay > 0)
+    {
+        return updateTimedLayer(index, layer, curPattern, forceUpdate);
+    }
+
     if (forceUpdate)
     {
-        incrementState(index, curPattern);
+        return incrementState(index, layer, curPattern);
+    }
+
+    if (!runZone.shouldUpdate())
+    {
+        return false;
+    }
+
+    if (runZone.frameDelay > 0 && millis() - runZone.lastUpdateMs >= 2u * runZone.frameDelay)
+    {
+        localPortStats(_port).overruns.increment();
+    }
+
+    // If we're done, make sure to stop if one shot is set
+    uint16_t stateCount = getStateCount(index, curPattern);
+    if (runZone.state >= stateCount)
+    {
+        if (runZone.oneShot)
+        {
+            runZone.doneRunning = true;
+            return false;
+        }
+        else
+        {
+            runZone.reset();
+        }
+
+        // Serial.printf("Reset zone index=%u, state=%d, lastUpdate=%lu\r\n",
+        //     index, runZone.state, runZone.lastUpdateMs);
+    }
+
+    return incrementState(index, layer, curPattern);
+}
+
+bool PatternZone::updateTimedLayer(uint16_t index, uint8_t layer, const Pattern *pattern,
+    bool forceUpdate)
+{
+    RunZone& runZone = getLayerRunZone(index, layer);
+
+    if (runZone.done() && !forceUpdate)
+    {
+        return false;
+    }
+
+    uint16_t stateCount = std::max<uint16_t>(getStateCount(index, pattern), 1);
+    // An epoch from another board can be a little ahead of this one's clock
+    int32_t elapsedMs = std::max<int32_t>(timebase.nowMs() - runZone.startMs, 0);
+    uint32_t step = pattern->animation ?
+        animationCache.stepAt(pattern->animation, elapsedMs, runZone.delay) :
+        elapsedMs / runZone.delay;
+
+    if (runZone.oneShot && step >= stateCount)
+    {
+        // Always end on the last state, even if its frame came too late to show
+        if (runZone.step == stateCount - 1u && !forceUpdate)
+        {
+            runZone.doneRunning = true;
+            return false;
+        }
+
+        step = stateCount - 1u;
+    }
 
+    // Also holds still if the timebase slews back a little
+    if (runZone.step != RunZone::NoStep && step <= runZone.step && !forceUpdate)
+    {
+        return false;
+    }
+
+    if (runZone.step != RunZone::NoStep && step > runZone.step + 1)
+    {
+        // States were skipped to stay on time
+        localPortStats(_port).overruns.increment();
+    }
+
+    runZone.step = step;
+    runZone.state = step % stateCount;
+    runZone.lastUpdateMs = millis();
+
+    return runPattern(index, layer, pattern);
+}
+
+void PatternZone::setEpoch(uint16_t index, uint32_t startMs)
+{
+    if (index >= _runZones->size())
+    {
         return;
     }
 
-    if (runZone.shouldUpdate())
+    RunZone& runZone = getRunZoneFromIndex(index);
+    if (!runZone.timed || runZone.startMs == startMs)
+    {
+        return;
+    }
+
+    runZone.startMs = startMs;
+    runZone.step = RunZone::NoStep;
+    runZone.doneRunning = false;
+}
+
+void PatternZone::publishEpoch(uint16_t index)
+{
+    RunZone& runZone = getRunZoneFromIndex(index);
+
+    if (runZone.timed)
+    {
+        timebase.setEpoch(_port, index, runZone.startMs);
+    }
+    else
+    {
+        timebase.clearEpoch(_port, index);
+    }
+}
+
+void PatternZone::composite(uint16_t index)
+{
+    auto& curZoneDef = getZoneDefinitionFromIndex(index);
+    auto& layers = getLayersFromIndex(index);
+
+    // Overlays with nothing to draw are skipped entirely
+    const OverlayLayer *active[Animation::maxZoneLayers];
+    uint8_t activeCount = 0;
+    for (auto& overlay : layers.overlays)
     {
-        // Serial.printf("Updating zone index=%u, state=%d, patternIndex=%d\r\n",
-        //     index, runZone.state, runZone.patternIndex);
-        // If we're done, make sure to stop if one shot is set
-        uint16_t stateCount = curPattern->mode == PatternStateMode::Constant ?
-            curPattern->numStates :
-            curZoneDef.count + curPattern->numStates;
-        if (runZone.state >= stateCount)
+        if (overlay.alpha > 0 && overlay.run.patternIndex != (uint8_t)PatternType::None)
         {
-            if (runZone.oneShot)
-            {
-                runZone.doneRunning = true;
-                return;
-            }
-            else
-            {
-                runZone.reset();
-            }
-
-            // Serial.printf("Reset zone index=%u, state=%d, lastUpdate=%lu\r\n",
-            //     index, runZone.state, runZone.lastUpdateMs);
+            active[activeCount++] = &overlay;
         }
+    }
+
+    ZoneView view(_leds, curZoneDef.offset, curZoneDef.count,
+        getRunZoneFromIndex(index).reversed);
+    const CRGB *base = layers.base.get();
+
+    // One pass over the pixels, stacking every layer onto each one in turn
+    for (uint16_t pixel = 0; pixel < curZoneDef.count; pixel++)
+    {
+        CRGB color = base[pixel];
 
-        if (incrementState(index, curPattern)) {
-            // Serial.printf("Showing %d\n", _port);
-            FastLED[_port].showLeds(_brightness);
+        for (uint8_t i = 0; i < activeCount; i++)
+        {
+            color = Blend::pixel(color, active[i]->pixels[pixel], active[i]->blend,
+                active[i]->alpha);
         }
+
+        view[pixel] = color;
+    }
+}
+
+void PatternZone::present(uint16_t index)
+{
+    if (!getLayersFromIndex(index).overlays.empty())
+    {
+        composite(index);
     }
+
+    markDirty(getRunZoneFromIndex(index));
+}
+
+bool PatternZone::flush()
+{
+    if (!_dirty)
+    {
+        return false;
+    }
+
+    uint32_t now = micros();
+    if (now - _lastShowUs < _frameIntervalUs)
+    {
+        return false;
+    }
+
+    // Serial.printf("Showing %d\n", _port);
+    uint32_t startUs = StatTimer::start();
+    ledOutputs[_port].show(_brightness);
+    localPortStats(_port).show.stop(startUs);
+
+    _lastShowUs = now;
+    _dirty = false;
+    _frameStats.shown++;
+
+    for (auto& zone : *_runZones)
+    {
+        zone.pendingShow = false;
+    }
+
+    return true;
+}
+
+void PatternZone::getStatus(PortStatus *status)
+{
+    status->zoneIndex = _zoneIndex;
+    status->zoneCount = std::min<size_t>(_runZones->size(), PinConstants::LED::MaxZones);
+
+    for (uint8_t i = 0; i < status->zoneCount; i++)
+    {
+        const RunZone& runZone = getRunZoneFromIndex(i);
+        status->zones[i] = {
+            .color = runZone.color,
+            .state = runZone.state,
+            .pattern = runZone.patternIndex,
+            .done = runZone.done(),
+        };
+    }
+}
+
+void PatternZone::setMaxFrameRate(uint16_t maxFrameRate)
+{
+    _frameIntervalUs = maxFrameRate == 0 ? 0 : 1000000ul / maxFrameRate;
+}
+
+void PatternZone::markDirty(RunZone& runZone)
+{
+    if (runZone.pendingShow)
+    {
+        _frameStats.dropped++;
+    }
+    else if (_dirty)
+    {
+        _frameStats.coalesced++;
+    }
+
+    runZone.pendingShow = true;
+    _dirty = true;
 }
 
-void PatternZone::setPattern(uint8_t patternIndex, uint16_t delay, bool isOneShot)
+void PatternZone::setPattern(uint8_t patternIndex, uint16_t delay, bool isOneShot,
+    bool isTimed)
 {
-    RunZone& runZone = getRunZoneFromIndex(_zoneIndex);
+    RunZone& runZone = getLayerRunZone(_zoneIndex, _layerIndex);
     
     if (patternIndex > PatternCount - 1)
     {
@@ -161,36 +435,50 @@ void PatternZone::setPattern(uint8_t patternIndex, uint16_t delay, bool isOneSho
 
     runZone.patternIndex = patternIndex;
     runZone.oneShot = isOneShot;
+    runZone.timed = isTimed;
     runZone.delay = delay;
+    runZone.frameDelay = delay;
     runZone.reset();
 
+    if (_layerIndex == 0)
+    {
+        publishEpoch(_zoneIndex);
+    }
+
     // Serial.printf("Set pattern to %d | one shot=%d | delay=%d | zone=%d\r\n", patternIndex,
     //                 isOneShot, delay, _zoneIndex);
     
-    updateZone(_zoneIndex, true);
+    if (updateLayer(_zoneIndex, _layerIndex, true))
+    {
+        present(_zoneIndex);
+    }
 }
 
 void PatternZone::setColor(uint32_t color)
 {
-    RunZone& runZone = getRunZoneFromIndex(_zoneIndex);
+    RunZone& runZone = getLayerRunZone(_zoneIndex, _layerIndex);
     runZone.color = color;
 
-    updateZone(_zoneIndex, true);
+    if (updateLayer(_zoneIndex, _layerIndex, true))
+    {
+        present(_zoneIndex);
+    }
 }
 
-bool PatternZone::incrementState(uint16_t index, Pattern *pattern)
+bool PatternZone::incrementState(uint16_t index, uint8_t layer, const Pattern *pattern)
 {
     // Serial.printf("Incrementing state for index=%u\r\n", index);
-    RunZone& runZone = getRunZoneFromIndex(index);
+    RunZone& runZone = getLayerRunZone(index, layer);
 
-    bool shouldUpdate = runPattern(index, pattern, _leds, runZone.color, runZone.state);
+    bool shouldUpdate = runPattern(index, layer, pattern);
     if (shouldUpdate)
     {
         // Serial.printf("Showing\r\n");
     }
 
+    runZone.frameDelay = getFrameDelay(runZone, pattern);
     runZone.state++;
     runZone.lastUpdateMs = millis();
 
     return shouldUpdate;
-}
\ No newline at end of file
+}
@@ -0,0 +1,322 @@
+#include "RadioTransfer.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Set on the last fragment of a run, which the receiver acks
+    constexpr uint8_t AckRequested = 0x01;
+    constexpr uint8_t AckLen = 8;
+}
+
+RadioTransfer::RadioTransfer(std::function<void(uint8_t, const uint8_t *, uint8_t)> sendFrame)
+    : _sendFrame(sendFrame)
+{
+}
+
+bool RadioTransfer::send(uint8_t address, const uint8_t *data, uint16_t len)
+{
+    if (_out.active || len == 0 || len > Radio::MaxTransferLen)
+    {
+        return false;
+    }
+
+    memcpy(_outData, data, len);
+
+    _out = {};
+    _out.active = true;
+    _out.address = address;
+    _out.id = _nextId++;
+    _out.count = (len + Radio::FragmentLen - 1) / Radio::FragmentLen;
+    _out.len = len;
+
+    return true;
+}
+
+bool RadioTransfer::due(uint8_t index, uint32_t nowMs) const
+{
+    if (_out.acked[index])
+    {
+        return false;
+    }
+
+    return !_out.sent[index] || _out.lost[index] ||
+        nowMs - _out.sentAtMs[index % Radio::TransferWindow] >= Radio::RetransmitMs;
+}
+
+int16_t RadioTransfer::nextDue(uint32_t nowMs, bool *more) const
+{
+    uint8_t end = std::min<uint16_t>(_out.base + Radio::TransferWindow, _out.count);
+    int16_t index = -1;
+    *more = false;
+
+    for (uint8_t i = _out.base; i < end; i++)
+    {
+        if (!due(i, nowMs))
+        {
+            continue;
+        }
+
+        if (index >= 0)
+        {
+            *more = true;
+            break;
+        }
+
+        index = i;
+    }
+
+    return index;
+}
+
+bool RadioTransfer::ready(uint32_t nowMs) const
+{
+    bool more;
+    return _out.active && nextDue(nowMs, &more) >= 0;
+}
+
+void RadioTransfer::update(uint32_t nowMs)
+{
+    if (_in.active && nowMs - _in.progressMs >= Radio::TransferTimeoutMs)
+    {
+        if (!_in.complete)
+        {
+            _stats.failed++;
+        }
+        _in.active = false;
+    }
+
+    if (!_out.active)
+    {
+        return;
+    }
+
+    // The clock starts with the first fragment sent
+    if (_out.sent.none())
+    {
+        _out.progressMs = nowMs;
+    }
+
+    if (nowMs - _out.progressMs >= Radio::TransferTimeoutMs)
+    {
+        _out.active = false;
+        _stats.failed++;
+        return;
+    }
+
+    bool more;
+    int16_t index = nextDue(nowMs, &more);
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    uint16_t offset = index * Radio::FragmentLen;
+    uint8_t len = std::min<uint16_t>(Radio::FragmentLen, _out.len - offset);
+    uint8_t frame[Radio::MaxDataLen];
+
+    frame[0] = Radio::TransferMagic;
+    frame[1] = _out.id;
+    frame[2] = index;
+    frame[3] = _out.count;
+    // Nothing else is due, so hear back about everything sent so far
+    frame[4] = more ? 0 : AckRequested;
+    memcpy(&frame[Radio::TransferHeaderLen], &_outData[offset], len);
+
+    if (_out.sent[index])
+    {
+        _stats.retransmits++;
+    }
+
+    uint8_t slot = index % Radio::TransferWindow;
+    _out.sent.set(index);
+    _out.lost.reset(index);
+    _out.sentAtMs[slot] = nowMs;
+    _out.order[slot] = ++_sendCount;
+    _stats.fragments++;
+
+    _sendFrame(_out.address, frame, Radio::TransferHeaderLen + len);
+}
+
+bool RadioTransfer::receive(uint8_t senderId, const uint8_t *data, uint8_t len, uint32_t nowMs)
+{
+    if (!isTransfer(data, len))
+    {
+        return false;
+    }
+
+    if (data[0] == Radio::TransferMagic)
+    {
+        receiveFragment(senderId, data, len, nowMs);
+    }
+    else
+    {
+        receiveAck(senderId, data, len, nowMs);
+    }
+
+    return true;
+}
+
+void RadioTransfer::receiveFragment(uint8_t senderId, const uint8_t *data, uint8_t len,
+    uint32_t nowMs)
+{
+    if (len < Radio::TransferHeaderLen)
+    {
+        return;
+    }
+
+    uint8_t id = data[1];
+    uint8_t index = data[2];
+    uint8_t count = data[3];
+    uint8_t flags = data[4];
+    uint8_t dataLen = len - Radio::TransferHeaderLen;
+
+    // Every fragment but the last is full
+    if (count == 0 || count > Radio::MaxFragments || index >= count ||
+        dataLen > Radio::FragmentLen || (index + 1 < count && dataLen != Radio::FragmentLen))
+    {
+        return;
+    }
+
+    if (!_in.active || _in.sender != senderId || _in.id != id || _in.count != count)
+    {
+        if (_in.active && !_in.complete)
+        {
+            // Still waiting on the rest of another transfer
+            if (nowMs - _in.progressMs < Radio::TransferTimeoutMs)
+            {
+                return;
+            }
+            _stats.failed++;
+        }
+
+        _in = {};
+        _in.active = true;
+        _in.sender = senderId;
+        _in.id = id;
+        _in.count = count;
+    }
+
+    _in.progressMs = nowMs;
+
+    // A fragment heard twice means the sender missed an ack
+    bool duplicate = _in.have[index];
+    if (!duplicate)
+    {
+        memcpy(&_inData[index * Radio::FragmentLen], &data[Radio::TransferHeaderLen], dataLen);
+        _in.have.set(index);
+
+        if (index + 1 == count)
+        {
+            _in.len = index * Radio::FragmentLen + dataLen;
+        }
+
+        while (_in.next < count && _in.have[_in.next])
+        {
+            _in.next++;
+        }
+    }
+
+    if (!_in.complete && _in.next == count)
+    {
+        _in.complete = true;
+        _stats.received++;
+        sendAck(index);
+
+        if (_receivedCb)
+        {
+            _receivedCb(_in.sender, _inData, _in.len);
+        }
+        return;
+    }
+
+    if (duplicate || (flags & AckRequested))
+    {
+        sendAck(index);
+    }
+}
+
+void RadioTransfer::receiveAck(uint8_t senderId, const uint8_t *data, uint8_t len,
+    uint32_t nowMs)
+{
+    if (len < AckLen || !_out.active || senderId != _out.address || data[1] != _out.id)
+    {
+        return;
+    }
+
+    uint8_t next = data[2];
+    uint8_t trigger = data[3];
+    uint32_t mask = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+
+    if (next > _out.count)
+    {
+        return;
+    }
+
+    uint8_t end = std::min<uint16_t>(_out.base + Radio::TransferWindow, _out.count);
+    bool triggerInWindow = trigger >= _out.base && trigger < end && _out.sent[trigger];
+    uint32_t triggerOrder = triggerInWindow ? _out.order[trigger % Radio::TransferWindow] : 0;
+    size_t ackedBefore = _out.acked.count();
+
+    for (uint8_t i = _out.base; i < next; i++)
+    {
+        _out.acked.set(i);
+    }
+
+    for (uint8_t bit = 0; bit < 32 && next + 1 + bit < _out.count; bit++)
+    {
+        if (mask & (1u << bit))
+        {
+            _out.acked.set(next + 1 + bit);
+        }
+    }
+
+    // Fragments sent before the one that drew this ack should have got there first
+    if (triggerInWindow)
+    {
+        for (uint8_t i = _out.base; i < end; i++)
+        {
+            if (!_out.acked[i] && _out.sent[i] &&
+                _out.order[i % Radio::TransferWindow] < triggerOrder)
+            {
+                _out.lost.set(i);
+            }
+        }
+    }
+
+    if (_out.acked.count() != ackedBefore)
+    {
+        _out.progressMs = nowMs;
+    }
+
+    while (_out.base < _out.count && _out.acked[_out.base])
+    {
+        _out.base++;
+    }
+
+    if (_out.base == _out.count)
+    {
+        _out.active = false;
+        _stats.sent++;
+    }
+}
+
+void RadioTransfer::sendAck(uint8_t trigger)
+{
+    uint32_t mask = 0;
+    for (uint8_t bit = 0; bit < 32 && _in.next + 1 + bit < _in.count; bit++)
+    {
+        if (_in.have[_in.next + 1 + bit])
+        {
+            mask |= 1u << bit;
+        }
+    }
+
+    uint8_t frame[AckLen] = {
+        Radio::TransferAckMagic, _in.id, _in.next, trigger,
+        (uint8_t)mask, (uint8_t)(mask >> 8), (uint8_t)(mask >> 16), (uint8_t)(mask >> 24),
+    };
+
+    _sendFrame(_in.sender, frame, AckLen);
+}
@@ -1,65 +1,162 @@
 #include "SpectrumAnalyzer.h"
 
-SpectrumAnalyzer::SpectrumAnalyzer()
-{
-  vReal = new float[FFT::SampleCount];
-  vImag = new float[FFT::SampleCount];
-  adcBuf = new uint8_t[FFT::SampleCount];
+#include "FixedFFT.h"
 
-  fft = std::make_unique<ArduinoFFT<float>>(vReal, vImag, FFT::SampleCount, FFT::SampleFrequencyHz);
-}
+#include <algorithm>
 
-SpectrumAnalyzer::~SpectrumAnalyzer()
-{
-  delete[] vReal;
-  delete[] vImag;
-  delete[] adcBuf;
-}
+SpectrumAnalyzer spectrum;
 
 void SpectrumAnalyzer::startSampling()
 {
-  Serial.printf("Started sampling\n");
+  // Serial.printf("Started sampling\n");
   adc_fifo_drain();
   adc_run(false);
 
-  dma_channel_configure(dmaChannel, &cfg, adcBuf, &adc_hw->fifo, FFT::SampleCount, true);
-
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    // Writes wrap back to the start of the buffer, ready for the next pass
+    channel_config_set_ring(&cfg[i], true, __builtin_ctz(samples));
+    channel_config_set_chain_to(&cfg[i], dmaChannels[i ^ 1]);
+    dma_hw->intr = 1u << dmaChannels[i];
+    dma_channel_configure(dmaChannels[i], &cfg[i], adcBufs[i], &adc_hw->fifo,
+      samples, false);
+  }
+
+  // The second starts itself when the first finishes, and so on
+  dma_channel_start(dmaChannels[0]);
   adc_run(true);
+  sampling = true;
 }
 
-void SpectrumAnalyzer::update()
+void SpectrumAnalyzer::stopSampling()
 {
-  dma_channel_wait_for_finish_blocking(dmaChannel);
-  digitalWriteFast(PinConstants::LED::AliveStatus, false);
-  Serial.printf("Has data true\n");
-  hasData = false;
+  adc_run(false);
 
-  memset(vImag, 0, FFT::SampleCount);
+  // Unchained first, so aborting one doesn't start the other
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    channel_config_set_chain_to(&cfg[i], dmaChannels[i]);
+    dma_channel_set_config(dmaChannels[i], &cfg[i], false);
+  }
 
-  uint64_t sum = 0;
-  for (uint16_t i = 0; i < FFT::SampleCount; i++)
-    sum += adcBuf[i];
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    dma_channel_abort(dmaChannels[i]);
+  }
 
-  float average = (float)sum / FFT::SampleCount;
+  adc_fifo_drain();
+  sampling = false;
+}
 
-  for (uint16_t i = 0; i < FFT::SampleCount; i++)
-    vReal[i] = (float)adcBuf[i] - average;
+bool SpectrumAnalyzer::setSampleCount(uint16_t count)
+{
+  if (!FixedFFT::supports(count))
+  {
+    return false;
+  }
 
-  fft->windowing(FFTWindow::Hamming, FFTDirection::Forward);
-  fft->compute(FFTDirection::Forward);
-  fft->complexToMagnitude();
+  bool wasSampling = sampling;
+  if (wasSampling)
+  {
+    stopSampling();
+  }
 
-  startSampling();
+  samples = count;
+
+  if (wasSampling)
+  {
+    startSampling();
+  }
+
+  return true;
 }
 
-uint16_t SpectrumAnalyzer::sampleCount() const
+void SpectrumAnalyzer::update()
 {
-  return FFT::SampleCount;
+  if (!sampling)
+  {
+    return;
+  }
+
+  // Whichever channel is running is filling its buffer, so the other one's is
+  // the newest full capture
+  uint8_t full = dma_channel_is_busy(dmaChannels[0]) ? 1 : 0;
+  uint32_t fullMask = 1u << dmaChannels[full];
+  uint32_t bothMask = fullMask | (1u << dmaChannels[full ^ 1]);
+  uint32_t finished = dma_hw->intr & bothMask;
+
+  if (!(finished & fullMask))
+  {
+    return;
+  }
+
+  if (finished == bothMask)
+  {
+    skippedCount++;
+  }
+  dma_hw->intr = finished;
+
+  // Taken out first, before the other channel finishes and this buffer
+  // starts filling again
+  uint32_t sum = 0;
+  for (uint16_t i = 0; i < samples; i++)
+  {
+    re[i] = adcBufs[full][i];
+    sum += adcBufs[full][i];
+  }
+
+  if (dma_channel_is_busy(dmaChannels[full]))
+  {
+    // Refilling had already started, so part of what was copied is newer
+    skippedCount++;
+    return;
+  }
+
+  // Centered on the mean and scaled to Q15 with headroom for a full swing
+  int32_t mean = (sum << 7) / samples;
+  for (uint16_t i = 0; i < samples; i++)
+  {
+    re[i] = (re[i] << 7) - mean;
+    im[i] = 0;
+  }
+
+  FixedFFT::window(re, samples);
+  FixedFFT::transform(re, im, samples);
+
+  // A full scale sine is 127.5 either side of the middle, 128 times that in
+  // Q15, and comes out as half that times the Hamming window's 0.54 average
+  constexpr float fullScale = 127.5f * 128 / 2 * 0.54f;
+  uint16_t binCount = samples / 2;
+  frame++;
+
+  published.write([this, binCount](SpectrumBins &bins)
+  {
+    for (uint8_t band = 0; band < FFT::BandCount; band++)
+    {
+      uint16_t first = band * binCount / FFT::BandCount;
+      uint16_t end = std::max<uint16_t>((band + 1) * binCount / FFT::BandCount, first + 1);
+
+      uint16_t loudest = 0;
+      for (uint16_t bin = first; bin < end; bin++)
+      {
+        loudest = std::max(loudest, FixedFFT::magnitude(re[bin], im[bin]));
+      }
+
+      bins.bins[band] = std::min(loudest / fullScale, 1.0f);
+    }
+    bins.frame = frame;
+  });
 }
 
-float* SpectrumAnalyzer::bins() const
+bool SpectrumAnalyzer::read(SpectrumBins *bins) const
 {
-  return vReal;
+  bool ok = published.read([bins](const SpectrumBins &latest) { *bins = latest; });
+  return ok && bins->frame > 0;
+}
+
+uint16_t SpectrumAnalyzer::sampleCount() const
+{
+  return samples;
 }
 
 void SpectrumAnalyzer::init()
@@ -77,11 +174,15 @@ void SpectrumAnalyzer::init()
   adc_set_clkdiv(FFT::ClockDivider);
   delay(1000);
 
-  dmaChannel = dma_claim_unused_channel(true);
-  Serial.printf("Got channel=%d\n", dmaChannel);
-  cfg = dma_channel_get_default_config(dmaChannel);
-  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
-  channel_config_set_read_increment(&cfg, false);
-  channel_config_set_write_increment(&cfg, true);
-  channel_config_set_dreq(&cfg, DREQ_ADC);
-}
\ No newline at end of file
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    dmaChannels[i] = dma_claim_unused_channel(true);
+    // Serial.printf("Got channel=%d\n", dmaChannels[i]);
+
+    cfg[i] = dma_channel_get_default_config(dmaChannels[i]);
+    channel_config_set_transfer_data_size(&cfg[i], DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg[i], false);
+    channel_config_set_write_increment(&cfg[i], true);
+    channel_config_set_dreq(&cfg[i], DREQ_ADC);
+  }
+}
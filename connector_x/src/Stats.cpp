@@ -0,0 +1,3 @@
+#include "Stats.h"
+
+PortStats portStats[2][PinConstants::LED::NumPorts];
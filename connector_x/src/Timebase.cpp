@@ -0,0 +1,164 @@
+#include "Timebase.h"
+
+#include <pico/stdlib.h>
+
+Timebase timebase;
+
+void Timebase::begin()
+{
+    mutex_init(&_mtx);
+}
+
+uint64_t Timebase::toNetworkUs(uint64_t localUs)
+{
+    ClockMapping clock;
+    // Only correct() writes, and never from an interrupt, so this can't spin for long
+    while (!_published.read([&clock](const ClockMapping &published) { clock = published; }))
+    {
+    }
+
+    int64_t elapsed = (int64_t)(localUs - clock.anchorLocalUs);
+    return clock.anchorNetworkUs + elapsed + elapsed * clock.driftPpm / 1000000;
+}
+
+uint64_t Timebase::nowUs()
+{
+    return toNetworkUs(time_us_64());
+}
+
+void Timebase::correct(uint64_t masterUs, uint64_t localUs)
+{
+    if (_master)
+    {
+        return;
+    }
+
+    uint64_t predictedUs = toNetworkUs(localUs);
+    int64_t error = (int64_t)(masterUs - predictedUs);
+
+    if (!_synced || error > (int64_t)Radio::SyncStepUs || error < -(int64_t)Radio::SyncStepUs)
+    {
+        _clock.anchorLocalUs = _refLocalUs = localUs;
+        _clock.anchorNetworkUs = _refNetworkUs = masterUs;
+        _synced = true;
+
+        _published.write([this](ClockMapping &clock) { clock = _clock; });
+        return;
+    }
+
+    // A beacon held up on the way reads as the master being behind, so those
+    // only nudge the clock back while early ones pull it forward quickly
+    _clock.anchorNetworkUs = predictedUs + (error > 0 ? error / 2 : error / 8);
+    _clock.anchorLocalUs = localUs;
+
+    // Measured across the corrected clock rather than raw beacons, and over a
+    // long span, so delivery jitter hardly shows in it
+    int64_t span = (int64_t)(localUs - _refLocalUs);
+    if (span >= (int64_t)Radio::DriftSpanUs)
+    {
+        int64_t ppm = ((int64_t)(_clock.anchorNetworkUs - _refNetworkUs) - span) * 1000000 / span;
+        _clock.driftPpm = (int32_t)std::max<int64_t>(-Radio::MaxDriftPpm,
+            std::min<int64_t>(ppm, Radio::MaxDriftPpm));
+    }
+
+    _published.write([this](ClockMapping &clock) { clock = _clock; });
+}
+
+void Timebase::setMaster(bool master)
+{
+    _master = master;
+}
+
+void Timebase::setEpoch(uint8_t port, uint8_t zone, uint32_t startMs)
+{
+    mutex_enter_blocking(&_mtx);
+
+    uint8_t i = 0;
+    while (i < _epochCount && (_epochs[i].port != port || _epochs[i].zone != zone))
+    {
+        i++;
+    }
+
+    if (i == Radio::MaxBeaconEpochs)
+    {
+        // Full, so the zone set longest ago goes
+        memmove(&_epochs[0], &_epochs[1], sizeof(ZoneEpoch) * (Radio::MaxBeaconEpochs - 1));
+        i--;
+    }
+    else if (i == _epochCount)
+    {
+        _epochCount++;
+    }
+
+    _epochs[i] = {startMs, port, zone};
+
+    mutex_exit(&_mtx);
+}
+
+void Timebase::clearEpoch(uint8_t port, uint8_t zone)
+{
+    mutex_enter_blocking(&_mtx);
+
+    for (uint8_t i = 0; i < _epochCount; i++)
+    {
+        if (_epochs[i].port == port && _epochs[i].zone == zone)
+        {
+            memmove(&_epochs[i], &_epochs[i + 1], sizeof(ZoneEpoch) * (_epochCount - i - 1));
+            _epochCount--;
+            break;
+        }
+    }
+
+    mutex_exit(&_mtx);
+}
+
+uint8_t Timebase::writeBeacon(uint8_t *buf)
+{
+    ZoneEpoch epochs[Radio::MaxBeaconEpochs];
+
+    mutex_enter_blocking(&_mtx);
+    uint8_t count = _epochCount;
+    memcpy(epochs, _epochs, sizeof(ZoneEpoch) * count);
+    mutex_exit(&_mtx);
+
+    // Stamped last, as close to going out as possible
+    return writeBeacon(buf, nowUs(), epochs, count);
+}
+
+uint8_t Timebase::writeBeacon(uint8_t *buf, uint64_t masterUs,
+    const ZoneEpoch *epochs, uint8_t count)
+{
+    buf[0] = Radio::BeaconMagic;
+    buf[1] = count;
+    memcpy(&buf[2], &masterUs, sizeof(masterUs));
+
+    uint8_t len = 10;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        buf[len++] = epochs[i].port;
+        buf[len++] = epochs[i].zone;
+        memcpy(&buf[len], &epochs[i].startMs, sizeof(epochs[i].startMs));
+        len += sizeof(epochs[i].startMs);
+    }
+
+    return len;
+}
+
+uint8_t Timebase::readBeacon(const uint8_t *data, uint8_t len, uint64_t *masterUs,
+    ZoneEpoch *epochs)
+{
+    memcpy(masterUs, &data[2], sizeof(*masterUs));
+
+    uint8_t count = std::min<uint8_t>(data[1], Radio::MaxBeaconEpochs);
+    count = std::min<uint8_t>(count, (len - 10) / 6);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const uint8_t *entry = &data[10 + i * 6];
+        epochs[i].port = entry[0];
+        epochs[i].zone = entry[1];
+        memcpy(&epochs[i].startMs, &entry[2], sizeof(epochs[i].startMs));
+    }
+
+    return count;
+}
@@ -18,20 +18,30 @@
 #include "Configuration.h"
 #include "TestCommands.h"
 #include "Constants.h"
+#include "LedOutput.h"
 #include "PacketRadio.h"
+#include "FftBenchmark.h"
+#include "PatternBenchmark.h"
+#include "PatternVm.h"
 #include "PatternZone.h"
+#include "RenderScheduler.h"
+#include "Seqlock.h"
 #include "SpectrumAnalyzer.h"
+#include "SpscRing.h"
+#include "Stats.h"
+#include "Status.h"
+#include "Timebase.h"
+#include "Wave.h"
 
+#include <algorithm>
 #include <memory>
 
 // Uncomment to enable radio module communications
 // #define ENABLE_RADIO
 // Uncomment to enable OwO touch
 // #define ENABLE_OWO
-
-static mutex_t i2cCommandMtx;
-static mutex_t radioDataMtx;
-static mutex_t commandMtx;
+// Uncomment to print pattern timings over Serial at startup
+// #define ENABLE_BENCHMARK
 
 // Give Core1 8K of stack space
 bool core1_separate_stack = true;
@@ -39,17 +49,34 @@ bool core1_separate_stack = true;
 // Forward declarations
 void receiveEvent(int);
 void requestEvent(void);
-void handleRadioDataReceive(Message msg);
+void handleRadioDataReceive(const Message *msgs, uint8_t count);
+void handleBeacon(const uint8_t *data, uint8_t len, uint64_t receivedUs);
+void handleTransfer(uint16_t teamNumber, const uint8_t *data, uint16_t len);
 void centralRespond(Response response);
 void initI2C0(void);
 void initPixels(uint8_t port);
 void handleCommand(Command cmd);
+void handleBatch(Command *cmds, uint8_t count);
+bool runsOnCore1(CommandType type);
+void renderPort(uint8_t port);
+void publishRenderStatus();
+void publishIoStatus();
+const ZoneStatus *selectedZone(const RenderStatus &status);
 
 CRGB *getPixels(uint8_t port);
 
-static volatile uint8_t receiveBuf[PinConstants::I2C::ReceiveBufSize];
-static volatile bool newData = false;
-static volatile bool newDataToParse = false;
+struct ReceiveSlot
+{
+    uint8_t length;
+    uint8_t data[PinConstants::I2C::ReceiveBufSize];
+    // Handle for the write's first RadioSend; any others take the ones after it
+    uint16_t sendHandle;
+};
+
+// Filled in place by receiveEvent, parsed in place by loop()
+static SpscRing<ReceiveSlot, PinConstants::I2C::ReceiveSlotCount> receiveSlots;
+// Only written on core0, by receiveEvent and loop()
+static ResponseReadI2CStats i2cStats;
 
 static volatile uint8_t ledPort = 0;
 static const std::vector<ZoneDefinition> defaultZoneDefs = {
@@ -61,13 +88,43 @@ static const std::vector<ZoneDefinition> defaultZoneDefs = {
 
 static CRGB *pixels[PinConstants::LED::NumPorts];
 static std::unique_ptr<PatternZone> zones[PinConstants::LED::NumPorts];
+// Ports by LED count, largest first, so core1 keeps the longest render
+static uint8_t renderOrder[PinConstants::LED::NumPorts];
 
 #ifdef ENABLE_RADIO
 static PacketRadio *radio;
+// 0 unless this board is the timebase master
+static uint16_t beaconIntervalMs = 0;
+static uint32_t lastBeaconMs = 0;
+// RadioSend handles are handed out by receiveEvent, so one can be read back
+// as soon as its write is in, before loop() has even queued the message.
+// Only touched by receiveEvent and requestEvent, which never interrupt each other.
+static uint16_t nextSendHandle = 1;
+static uint16_t lastSendHandle = 0;
+// The handle for the next RadioSend handleCommand queues
+static uint16_t queuedSendHandle = 0;
+
+// Handles wrap around to 1, since 0 is never one
+static uint16_t followingSendHandle(uint16_t handle)
+{
+    return handle == 0xFFFF ? 1 : handle + 1;
+}
 #endif
 
+// The last write, parsed by receiveEvent for requestEvent to answer, so a
+// read right after a write never answers the one before it
 static Command command;
-static CommandDeque commandDequeue;
+// Filled by core0 in handleCommand, drained by core1 in loop1
+static SpscRing<Command, CommandQueueSize> commandQueue;
+static StatTimer loop1Period;
+// What the read commands answer with, so requestEvent only has to copy
+static Seqlock<RenderStatus> renderStatus;
+static Seqlock<IoStatus> ioStatus;
+// Core0's working copy of ioStatus, and what was last published from it
+static IoStatus io = {};
+static IoStatus ioPublished = {};
+// Each port is one job, so a port's zones only ever render on one core at a time
+static RenderScheduler<PinConstants::LED::NumPorts> renderScheduler(renderPort);
 
 #ifdef ENABLE_OWO
 static Adafruit_MPR121 cap;
@@ -113,10 +170,7 @@ void setup()
     Serial1.setRX(PinConstants::UART::RX);
     Serial1.begin(UartBaudRate);
 
-    mutex_init(&i2cCommandMtx);
-    mutex_init(&radioDataMtx);
-    mutex_init(&commandMtx);
-    mutex_init(&spectrumMtx);
+    timebase.begin();
 
     LittleFSConfig cfg;
     cfg.setAutoFormat(false);
@@ -124,6 +178,22 @@ void setup()
 
     LittleFS.begin();
 
+    for (uint8_t slot = 0; slot < Animation::programSlots; slot++)
+    {
+        char path[16];
+        snprintf(path, sizeof(path), "/program%d.pvm", slot);
+        programs[slot].loadFile(path);
+    }
+
+    #ifdef ENABLE_BENCHMARK
+    // Core1 is idled, so the patterns have the CPU to themselves
+    PatternBenchmark::run(Serial);
+    if (!FftBenchmark::run(Serial))
+    {
+        Serial.println("FFT accuracy is outside its limits");
+    }
+    #endif
+
     #ifdef ENABLE_OWO
     cap.begin(0x5A, &Wire1);
     #endif
@@ -142,16 +212,21 @@ void setup()
     initPixels(0);
     initPixels(1);
 
+    for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
+    {
+        renderOrder[port] = port;
+    }
+    std::sort(renderOrder, renderOrder + PinConstants::LED::NumPorts,
+        [](uint8_t a, uint8_t b) { return ledOutputs[a].size() > ledOutputs[b].size(); });
+
     rp2040.resumeOtherCore();
 
 
 #ifdef ENABLE_RADIO
-    radio = new PacketRadio(&SPI1, config, handleRadioDataReceive);
-
-    for (int i = 0; i < 2; i++)
-    {
-        radio->addTeam(config.initialTeams[i]);
-    }
+    radio = new PacketRadio(&SPI1, configuration, handleRadioDataReceive);
+    radio->init();
+    radio->onBeacon(handleBeacon);
+    radio->onTransfer(handleTransfer);
 #endif
 
     // Serial.printf("Got config:\r\n%s\r\n",
@@ -168,12 +243,16 @@ void setup()
 
     digitalWrite(PinConstants::CONFIG::ConfigLed, LOW);
 
-    // spectrum.init();
+#ifdef ENABLE_SPECTRUM
+    spectrum.init();
+#endif
 
     rp2040.resumeOtherCore();
     rp2040.restartCore1();
 
-    // spectrum.startSampling();
+#ifdef ENABLE_SPECTRUM
+    spectrum.startSampling();
+#endif
 }
 
 void setup1()
@@ -184,24 +263,21 @@ void setup1()
 
 void loop1()
 {
-    mutex_enter_blocking(&commandMtx);
-    bool available = commandDequeue.nextCommandAvailable();
-    mutex_exit(&commandMtx);
+    loop1Period.lap();
 
-    if (available)
-    {
-        Command cmd{};
-        // Serial.printf("fifo available\n");
-        mutex_enter_blocking(&commandMtx);
-        int remaining = commandDequeue.getNextCommand(&cmd);
-        mutex_exit(&commandMtx);
+    Command cmd{};
+    // Commands left in the current batch, all applied before the next frame
+    uint8_t batchRemaining = 0;
 
-        // Serial.printf("remaining = %d\n", remaining);
+    // Lock-free, so an empty queue costs two loads
+    while (commandQueue.pop(&cmd))
+    {
         // Serial.printf("cmd type = %d\n", (uint8_t)cmd.commandType);
 
-        if (remaining == -1) {
-            // Serial.printf("ERROR: no actual commands to process\n");
-            return;
+        if (cmd.commandType == CommandType::Batch)
+        {
+            batchRemaining = cmd.commandData.commandBatch.count;
+            continue;
         }
 
         switch (cmd.commandType)
@@ -224,9 +300,9 @@ void loop1()
                 // Set LEDs to black and stop running the pattern
                 for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
                 {
-                    auto pixels = getPixels(ledPort);
-                    Animation::executePatternSetAll(pixels, 0, 0, FastLED[port].size());
-                    FastLED[port].showLeds();
+                    uint16_t count = ledOutputs[port].size();
+                    Animation::executePatternSetAll(ZoneView(getPixels(port), count), 0, 0, count);
+                    ledOutputs[port].show();
                 }
                 systemOn = false;
                 break;
@@ -247,7 +323,8 @@ void loop1()
 
                 zones[ledPort]->setPattern(data.pattern,
                                         delay,
-                                        data.oneShot);
+                                        data.oneShot,
+                                        data.timed);
                 break;
             }
 
@@ -257,14 +334,6 @@ void loop1()
 
                 // Serial.printf("Color=%d|%d|%d\n", data.red, data.green, data.blue);
 
-                // Handle port 0 being RGB instead of GRB
-                if (ledPort == 0)
-                {
-                    uint8_t temp = data.red;
-                    data.red = data.green;
-                    data.green = temp;
-                }
-
                 zones[ledPort]->setColor(
                     (uint32_t)CRGB(data.red, data.green, data.blue));
                 break;
@@ -303,7 +372,8 @@ void loop1()
                 auto& ledConfig = ledPort == 0 ? configuration.led0 : configuration.led1;
 
                 zones[ledPort] = std::make_unique<PatternZone>(
-                    ledPort, ledConfig.brightness, pixels[ledPort], zoneDefs);
+                    ledPort, ledConfig.brightness, pixels[ledPort], zoneDefs,
+                    ledConfig.maxFrameRate);
 
                 // Serial.printf("Set %d new zones\r\n", data.zoneCount);
 
@@ -317,20 +387,118 @@ void loop1()
                 zones[ledPort]->resetZones(data.zones, data.zoneCount);
         // Serial.print(F("ON="));
         // Serial.println(systemOn);
+                break;
+            }
+
+            case CommandType::SetWave:
+            {
+                CommandSetWave data = cmd.commandData.commandSetWave;
+
+                if ((PatternType)data.pattern == PatternType::SineRoll)
+                {
+                    Wave::sineRoll.speed = data.speed;
+                    Wave::sineRoll.wavelength = data.wavelength;
+                }
+                else if ((PatternType)data.pattern == PatternType::Breathing)
+                {
+                    Wave::breathing.speed = data.speed;
+                }
+                break;
+            }
+
+            case CommandType::SetPatternLayer:
+            {
+                CommandSetPatternLayer data = cmd.commandData.commandSetPatternLayer;
+
+                zones[ledPort]->setLayer(data.layer, data.alpha,
+                    (BlendMode)data.blendMode);
+                break;
+            }
+
+            case CommandType::LoadProgram:
+            {
+                CommandLoadProgram data = cmd.commandData.commandLoadProgram;
+
+                if (data.slot < Animation::programSlots)
+                {
+                    programs[data.slot].write(data.offset, data.code,
+                        data.length, data.last);
+                }
+                break;
+            }
+
+            case CommandType::SetZoneEpoch:
+            {
+                CommandSetZoneEpoch data = cmd.commandData.commandSetZoneEpoch;
+
+                if (data.port < PinConstants::LED::NumPorts)
+                {
+                    zones[data.port]->setEpoch(data.zoneIndex, data.startMs);
+                }
+                break;
             }
         }
+
+        if (batchRemaining == 0 || --batchRemaining == 0)
+        {
+            break;
+        }
     }
 
     if (systemOn)
     {
-        // zones[1]->updateZones();
-        for (int i = 0; i < PinConstants::LED::NumPorts; i++)
+        // Core0 picks up a port between I2C writes if it gets there first
+        renderScheduler.open();
+        renderScheduler.finish();
+    }
+
+    // Start any frame that was waiting for its port's previous frame to finish
+    for (int i = 0; i < PinConstants::LED::NumPorts; i++)
+    {
+        ledOutputs[i].update();
+    }
+
+    publishRenderStatus();
+}
+
+void publishRenderStatus()
+{
+    renderStatus.write([](RenderStatus &status)
+    {
+        status.ledPort = ledPort;
+
+        for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
         {
-            zones[i]->updateZones();
+            zones[port]->getStatus(&status.ports[port]);
         }
+    });
+}
+
+void publishIoStatus()
+{
+    for (auto pin : PinConstants::DIGITALIO::digitalIOMap)
+    {
+        io.digital[pin.first] = digitalRead(pin.second);
+    }
+
+#ifdef ENABLE_RADIO
+    io.radioStats = radio->stats();
+    io.transferStats = radio->transferStats();
+    radio->getSendRecords(io.sends);
+#endif
+
+    if (memcmp(&io, &ioPublished, sizeof(io)) != 0)
+    {
+        ioPublished = io;
+        ioStatus.write([](IoStatus &status) { status = io; });
     }
 }
 
+void renderPort(uint8_t job)
+{
+    zones[renderOrder[job]]->updateZones();
+}
+
 CRGB *getPixels(uint8_t port)
 {
     if (port < PinConstants::LED::NumPorts)
@@ -343,40 +511,62 @@ CRGB *getPixels(uint8_t port)
 
 void loop()
 {
-    // mutex_enter_blocking(&spectrumMtx);
-    // spectrum.update();
-    // mutex_exit(&spectrumMtx);
-
-    // If there's new data, process it
-    if (newDataToParse)
-    {
-        uint8_t buf[PinConstants::I2C::ReceiveBufSize];
-        // Copy our new data
-        mutex_enter_blocking(&i2cCommandMtx);
-        memcpy(buf, (const void *)receiveBuf, PinConstants::I2C::ReceiveBufSize);
-        mutex_exit(&i2cCommandMtx);
+#ifdef ENABLE_SPECTRUM
+    // Returns straight away unless a capture has filled since the last pass
+    spectrum.update();
+#endif
+
+    // Parse everything that came in since the last pass, oldest first
+    ReceiveSlot *slot;
+    while ((slot = receiveSlots.front()) != nullptr)
+    {
         // Serial.printf("Rec data buffer=\t");
-        // for (int i = 0; i < 16; i++)
+        // for (int i = 0; i < slot->length; i++)
         // {
-        //     Serial.printf("%X ", receiveBuf[i]);
+        //     Serial.printf("%X ", slot->data[i]);
         // }
         // Serial.println();
+#ifdef ENABLE_RADIO
+        queuedSendHandle = slot->sendHandle;
+#endif
         Command cmdTemp{};
-        CommandParser::parseCommand(buf, PinConstants::I2C::ReceiveBufSize, &cmdTemp);
-
-        command = cmdTemp;
+        if (!CommandParser::parseCommand(slot->data, slot->length, &cmdTemp))
+        {
+            i2cStats.rejected++;
+        }
 
-        newDataToParse = false;
-        newData = false;
         // Serial.printf("Command struct=\t");
-        // for (int i = 0; i < sizeof(command); i++)
+        // for (int i = 0; i < sizeof(cmdTemp); i++)
         // {
-        //     Serial.printf("%X ", ((uint8_t *)&command)[i]);
+        //     Serial.printf("%X ", ((uint8_t *)&cmdTemp)[i]);
         // }
         // Serial.println();
-        handleCommand(cmdTemp);
+        if (cmdTemp.commandType == CommandType::Batch)
+        {
+            Command cmds[PinConstants::I2C::MaxBatchCommands];
+            bool rejected = false;
+            uint8_t count = CommandParser::parseBatch(slot->data, slot->length,
+                cmds, PinConstants::I2C::MaxBatchCommands, &rejected);
+
+            if (rejected)
+            {
+                i2cStats.rejected++;
+            }
+
+            handleBatch(cmds, count);
+        }
+        else
+        {
+            handleCommand(cmdTemp);
+        }
+
+        receiveSlots.release();
     }
 
+    // Only once I2C has caught up, and only one port per pass, so the next
+    // write waits for at most one port's render
+    renderScheduler.runOne();
+
     #ifdef ENABLE_OWO
     curTouched = cap.touched();
 
@@ -459,39 +649,159 @@ void loop()
     lastTouched = curTouched;
     #endif
 
+    publishIoStatus();
+
 #ifdef ENABLE_RADIO
+    if (beaconIntervalMs > 0 && millis() - lastBeaconMs >= beaconIntervalMs)
+    {
+        radio->sendBeacon();
+        lastBeaconMs = millis();
+    }
+
     radio->update();
 #endif
 }
 
-void handleRadioDataReceive(Message msg)
+void handleBeacon(const uint8_t *data, uint8_t len, uint64_t receivedUs)
+{
+    uint64_t masterUs;
+    ZoneEpoch epochs[Radio::MaxBeaconEpochs];
+    uint8_t count = Timebase::readBeacon(data, len, &masterUs, epochs);
+
+    // The master stamped it before it went out, so it has been on the air since
+    timebase.correct(masterUs + Timebase::airtimeUs(len), receivedUs);
+
+    if (timebase.isMaster())
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Command epochCmd{};
+        epochCmd.commandType = CommandType::SetZoneEpoch;
+        epochCmd.commandData.commandSetZoneEpoch = {
+            .startMs = epochs[i].startMs,
+            .zoneIndex = epochs[i].zone,
+            .port = epochs[i].port,
+        };
+
+        commandQueue.push(epochCmd);
+    }
+}
+
+void handleTransfer(uint16_t teamNumber, const uint8_t *data, uint16_t len)
 {
-    mutex_enter_blocking(&radioDataMtx);
-    // Serial.println("New data:");
-    // Serial.printf("Team = %d\n", msg.teamNumber);
-    // Serial.printf("Data len = %d\n", msg.len);
-    // Serial.print("Data (HEX) = ");
+    // Only pattern programs for now: [TransferProgram][slot][code...]
+    if (len < 2 || data[0] != Radio::TransferProgram)
+    {
+        return;
+    }
+
+    uint8_t slot = data[1];
+    const uint8_t *code = &data[2];
+    uint16_t codeLen = len - 2;
 
-    // for (uint8_t i = 0; i < msg.len; i++)
+    if (slot >= Animation::programSlots || codeLen > Animation::programMaxSize)
+    {
+        return;
+    }
+
+    // Loaded the same way as LoadProgram writes over I2C, all or nothing
+    Command chunks[Animation::programMaxSize / Animation::programChunkSize + 1];
+    uint8_t chunkCount = 0;
+    uint16_t offset = 0;
+
+    do
+    {
+        uint8_t length = std::min<uint16_t>(codeLen - offset, Animation::programChunkSize);
+
+        Command &chunk = chunks[chunkCount++];
+        chunk = {};
+        chunk.commandType = CommandType::LoadProgram;
+        chunk.commandData.commandLoadProgram.slot = slot;
+        chunk.commandData.commandLoadProgram.offset = offset;
+        chunk.commandData.commandLoadProgram.length = length;
+        chunk.commandData.commandLoadProgram.last = offset + length == codeLen;
+        memcpy(chunk.commandData.commandLoadProgram.code, &code[offset], length);
+
+        offset += length;
+    } while (offset < codeLen);
+
+    commandQueue.push(chunks, chunkCount);
+}
+
+void handleRadioDataReceive(const Message *msgs, uint8_t count)
+{
+    // for (uint8_t m = 0; m < count; m++)
     // {
-    //     Serial.printf("%02X ", msg.data[i]);
-    // }
+    //     Serial.println("New data:");
+    //     Serial.printf("Team = %d\n", msgs[m].teamNumber);
+    //     Serial.printf("Data len = %d\n", msgs[m].len);
+    //     Serial.print("Data (HEX) = ");
 
-    // Serial.println();
+    //     for (uint8_t i = 0; i < msgs[m].len; i++)
+    //     {
+    //         Serial.printf("%02X ", msgs[m].data[i]);
+    //     }
 
-    mutex_exit(&radioDataMtx);
+    //     Serial.println();
+    // }
+
+    // Published with the radio's counters by the next publishIoStatus()
+    io.lastRadioMessage = msgs[count - 1];
 }
 
 void receiveEvent(int howMany)
 {
-    Wire.readBytes((uint8_t *)receiveBuf, howMany);
-    newDataToParse = true;
+    ReceiveSlot *slot = howMany > 0 ? receiveSlots.claim() : nullptr;
+
+    if (slot)
+    {
+        if (howMany > PinConstants::I2C::ReceiveBufSize)
+        {
+            i2cStats.overruns++;
+            howMany = PinConstants::I2C::ReceiveBufSize;
+        }
+
+        slot->length = Wire.readBytes(slot->data, howMany);
+#ifdef ENABLE_RADIO
+        slot->sendHandle = nextSendHandle;
+
+        uint8_t sends = CommandParser::countCommands(slot->data, slot->length,
+            CommandType::RadioSend);
+        for (uint8_t i = 0; i < sends; i++)
+        {
+            lastSendHandle = nextSendHandle;
+            nextSendHandle = followingSendHandle(nextSendHandle);
+        }
+#endif
+        // Parsed again by loop(), but only this copy is read here
+        CommandParser::parseCommand(slot->data, slot->length, &command);
+        receiveSlots.publish();
+        i2cStats.received++;
+    }
+    else if (howMany > 0)
+    {
+        i2cStats.dropped++;
+        // So a read of it answers 0xFF, not whatever was written before
+        command.commandType = (CommandType)0xff;
+    }
+
+    // Throw away whatever didn't fit
+    while (Wire.available())
+    {
+        Wire.read();
+    }
 }
 
+// Only copies out of what core0 and core1 last published, so it can't block
+// or throw whatever it interrupted
 void requestEvent()
 {
     Response res{};
     res.commandType = command.commandType;
+    bool ok = true;
     // Serial.printf("Sending back command=%d\n", (uint8_t)res.commandType);
 
     switch (command.commandType)
@@ -502,8 +812,10 @@ void requestEvent()
      */
     case CommandType::ReadPatternDone:
     {
-        // auto done = getPatternRunner(ledPort)->patternDone();
-        res.responseData.responsePatternDone.done = false;
+        ok = renderStatus.read([&res](const RenderStatus &status) {
+            const ZoneStatus *zone = selectedZone(status);
+            res.responseData.responsePatternDone.done = zone && zone->done;
+        });
         break;
     }
 
@@ -513,46 +825,135 @@ void requestEvent()
      */
     case CommandType::DigitalRead:
     {
-        uint8_t value = digitalRead(PinConstants::DIGITALIO::digitalIOMap.at(
-            command.commandData.commandDigitalRead.port));
-        res.responseData.responseDigitalRead.value = value;
+        uint8_t port = command.commandData.commandDigitalRead.port;
+        if (port >= PinConstants::DIGITALIO::PortCount)
+        {
+            ok = false;
+            break;
+        }
+
+        ok = ioStatus.read([&res, port](const IoStatus &status) {
+            res.responseData.responseDigitalRead.value = status.digital[port];
+        });
         break;
     }
 
 #ifdef ENABLE_RADIO
     case CommandType::RadioGetLatestReceived:
     {
-        mutex_enter_blocking(&radioDataMtx);
-        auto msg = radio->getLastReceived();
-        mutex_exit(&radioDataMtx);
+        ok = ioStatus.read([&res](const IoStatus &status) {
+            res.responseData.responseRadioLastReceived.msg = status.lastRadioMessage;
+        });
+        break;
+    }
+
+    case CommandType::RadioSend:
+    {
+        res.responseData.responseRadioSend.handle = lastSendHandle;
+        break;
+    }
+
+    case CommandType::RadioSendStatus:
+    {
+        uint16_t handle = command.commandData.commandRadioSendStatus.handle;
+
+        ok = ioStatus.read([&res, handle](const IoStatus &status) {
+            auto &sendStatus = res.responseData.responseRadioSendStatus;
+            sendStatus = {handle, SendStatus::Unknown};
 
-        res.responseData.responseRadioLastReceived.msg = msg;
+            for (const SendRecord &record : status.sends)
+            {
+                if (record.handle == handle)
+                {
+                    sendStatus.status = record.status;
+                }
+            }
+        });
+        break;
+    }
+
+    case CommandType::ReadRadioStats:
+    {
+        ok = ioStatus.read([&res](const IoStatus &status) {
+            res.responseData.responseReadRadioStats.stats = status.radioStats;
+            res.responseData.responseReadRadioStats.transfers = status.transferStats;
+        });
         break;
     }
 #endif
 
     case CommandType::ReadConfig:
     {
+        res.responseData.responseReadConfiguration.protocolVersion = ProtocolVersion;
         // res.responseData.responseReadConfiguration.config = configuration;
         break;
     }
 
     case CommandType::GetColor:
     {
-        // auto runner = getPatternRunner(ledPort);
-        // uint32_t msg = runner->getCurrentColor();
-
-        res.responseData.responseReadColor.color = 0x00;
+        ok = renderStatus.read([&res](const RenderStatus &status) {
+            const ZoneStatus *zone = selectedZone(status);
+            res.responseData.responseReadColor.color = zone ? zone->color : 0;
+        });
         break;
     }
 
     case CommandType::GetPort:
     {
-        res.responseData.responseReadPort.port = ledPort;
+        ok = renderStatus.read([&res](const RenderStatus &status) {
+            res.responseData.responseReadPort.port = status.ledPort;
+        });
+        break;
+    }
+
+    case CommandType::ReadI2CStats:
+    {
+        res.responseData.responseReadI2CStats = i2cStats;
+        break;
+    }
+
+#ifdef ENABLE_STATS
+    case CommandType::ReadStats:
+    {
+        auto &stats = res.responseData.responseReadStats;
+        auto snapshot = [](const StatTimer &timer) {
+            return TimerSnapshot{timer.minUs(), timer.avgUs(), timer.maxUs()};
+        };
+
+        for (uint8_t port = 0; port < PinConstants::LED::NumPorts; port++)
+        {
+            // Whichever core rendered each frame kept its own stats
+            StatTimer render = portStats[0][port].render;
+            StatTimer show = portStats[0][port].show;
+            render.merge(portStats[1][port].render);
+            show.merge(portStats[1][port].show);
+
+            stats.ports[port] = {
+                .overruns = portStats[0][port].overruns.value() +
+                    portStats[1][port].overruns.value(),
+                .render = snapshot(render),
+                .show = snapshot(show),
+            };
+        }
+
+        stats.i2cReceived = i2cStats.received;
+        stats.i2cDropped = i2cStats.dropped;
+        stats.queueOverflows = commandQueue.overflows();
+        stats.loop1Period = snapshot(loop1Period);
+        stats.queueDepth = commandQueue.size();
+        stats.queueHighWater = commandQueue.highWater();
+        stats.protocolVersion = ProtocolVersion;
         break;
     }
+#endif
 
     default:
+        ok = false;
+        break;
+    }
+
+    if (!ok)
+    {
         // Send back 255 (-1 signed) to indicate bad/no data
         Wire.write(0xff);
         return;
@@ -561,6 +962,22 @@ void requestEvent()
     centralRespond(res);
 }
 
+const ZoneStatus *selectedZone(const RenderStatus &status)
+{
+    if (status.ledPort >= PinConstants::LED::NumPorts)
+    {
+        return nullptr;
+    }
+
+    const PortStatus &port = status.ports[status.ledPort];
+    if (port.zoneIndex >= port.zoneCount)
+    {
+        return nullptr;
+    }
+
+    return &port.zones[port.zoneIndex];
+}
+
 void centralRespond(Response response)
 {
     uint16_t size;
@@ -585,6 +1002,21 @@ void centralRespond(Response response)
     case CommandType::GetPort:
         size = sizeof(ResponseReadPort);
         break;
+    case CommandType::ReadI2CStats:
+        size = sizeof(ResponseReadI2CStats);
+        break;
+    case CommandType::ReadStats:
+        size = sizeof(ResponseReadStats);
+        break;
+    case CommandType::ReadRadioStats:
+        size = sizeof(ResponseReadRadioStats);
+        break;
+    case CommandType::RadioSend:
+        size = sizeof(ResponseRadioSend);
+        break;
+    case CommandType::RadioSendStatus:
+        size = sizeof(ResponseRadioSendStatus);
+        break;
     default:
         size = 0;
     }
@@ -652,78 +1084,35 @@ void initPixels(uint8_t port)
 
     auto* strip = new CRGB[ledCount];
     pixels[port] = strip;
-    zones[port] = std::make_unique<PatternZone>(port, config.brightness, pixels[port], ledZones);
+    zones[port] = std::make_unique<PatternZone>(port, config.brightness, pixels[port], ledZones,
+        config.maxFrameRate);
 
-    if (port == 0)
-    {
-        FastLED.addLeds<WS2812, PinConstants::LED::Dout0, RGB>(pixels[port], ledCount);
-    }
-    else
-    {
-        FastLED.addLeds<WS2812, PinConstants::LED::Dout1, GRB>(pixels[port], ledCount);
-    }
+    ledOutputs[port].begin(new PioLedTransport(),
+        port == 0 ? PinConstants::LED::Dout0 : PinConstants::LED::Dout1,
+        pixels[port], ledCount, config.output);
 
     // Serial.printf("zones size=%d\r\n", zones[port]->_zones->size());
 
-    FastLED[port].clearLedData();
+    memset((void *)pixels[port], 0, sizeof(CRGB) * ledCount);
     pixels[port][0] = CRGB(255, 127, 31);
-    FastLED[port].showLeds();
+    ledOutputs[port].show();
     delay(1000);
     // Initialize all LEDs to black
-    Animation::executePatternSetAll(pixels[port], 0, 0, FastLED[port].size());
-    FastLED[port].showLeds();
+    Animation::executePatternSetAll(ZoneView(pixels[port], ledCount), 0, 0, ledCount);
+    ledOutputs[port].show();
     // Serial.println("Pixel end");
 }
 
 void handleCommand(Command cmd)
 {
-    switch (cmd.commandType)
-    {
-    case CommandType::On:
-    {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        // Go back to running the current color and pattern
-        break;
-    }
-
-    case CommandType::Off:
+    if (runsOnCore1(cmd.commandType))
     {
-        mutex_enter_blocking(&commandMtx);
-        // Set LEDs to black and stop running the pattern
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
-    }
-
-    case CommandType::Pattern:
-    {
-        mutex_enter_blocking(&commandMtx);
-        // To set everything to a certain color, change color then call
-        // the 'set all' pattern
-        
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
-    }
-
-    case CommandType::ChangeColor:
-    {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
+        commandQueue.push(cmd);
+        return;
     }
 
-    case CommandType::SetLedPort:
+    switch (cmd.commandType)
     {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
-    }
-
     case CommandType::DigitalSetup:
     {
         auto cfg = cmd.commandData.commandDigitalSetup;
@@ -750,45 +1139,93 @@ void handleCommand(Command cmd)
     }
 
 #ifdef ENABLE_RADIO
+    case CommandType::RadioSync:
+    {
+        beaconIntervalMs = cmd.commandData.commandRadioSync.beaconIntervalMs;
+        timebase.setMaster(beaconIntervalMs > 0);
+        break;
+    }
+
     case CommandType::RadioSend:
     {
-        auto message = command.commandData.commandRadioSend.msg;
+        // Only queued here; update() sends it once the air is clear
+        auto message = cmd.commandData.commandRadioSend.msg;
+        uint16_t handle = queuedSendHandle;
+        queuedSendHandle = followingSendHandle(handle);
+
         if (message.teamNumber == Radio::SendToAll)
         {
-            radio->sendToAll(message);
+            radio->sendToAll(message, handle);
         }
         else
         {
-            radio->send(message);
+            radio->send(message, handle);
         }
+        break;
     }
 #endif
 
-    case CommandType::SetPatternZone:
-    {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
+    default:
         break;
     }
+}
 
+bool runsOnCore1(CommandType type)
+{
+    switch (type)
+    {
+    case CommandType::On:
+    case CommandType::Off:
+    case CommandType::Pattern:
+    case CommandType::ChangeColor:
+    case CommandType::SetLedPort:
+    case CommandType::SetPatternZone:
     case CommandType::SetNewZones:
+    case CommandType::SyncStates:
+    case CommandType::SetWave:
+    case CommandType::SetPatternLayer:
+    case CommandType::LoadProgram:
+    case CommandType::SetZoneEpoch:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Core0 can't wait on core1 mid-batch, so a batch is split: core0's own
+// commands run here and now, and the LED commands go to core1 together to be
+// applied before its next frame. Order is kept within each half only.
+void handleBatch(Command *cmds, uint8_t count)
+{
+    // Slot 0 is the Batch header telling core1 how many follow
+    Command queued[PinConstants::I2C::MaxBatchCommands + 1];
+    uint8_t queuedCount = 1;
+
+    for (uint8_t i = 0; i < count; i++)
     {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
+        if (runsOnCore1(cmds[i].commandType))
+        {
+            queued[queuedCount++] = cmds[i];
+        }
+        else
+        {
+            handleCommand(cmds[i]);
+        }
     }
 
-    case CommandType::SyncStates:
+    if (queuedCount == 1)
     {
-        mutex_enter_blocking(&commandMtx);
-        commandDequeue.pushCommand(cmd);
-        mutex_exit(&commandMtx);
-        break;
+        return;
     }
 
-    default:
-        break;
+    queued[0] = {};
+    queued[0].commandType = CommandType::Batch;
+    queued[0].commandData.commandBatch.count = queuedCount - 1;
+
+    // Published in one go, so core1 never sees part of a batch
+    if (!commandQueue.push(queued, queuedCount))
+    {
+        i2cStats.batchesDropped++;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,75 @@
+#include <unity.h>
+
+#include "AnimationCache.h"
+#include "Configuration.h"
+
+// Loads the packed animations in data through caches of different budgets:
+// run with `pio test -e native` from connector_x, so the animations in data load
+
+namespace
+{
+    const MatrixConfiguration &matrixConfig = configuration.led1.matrix;
+
+    uint16_t ledCount()
+    {
+        return matrixConfig.width * matrixConfig.height;
+    }
+}
+
+void test_missing_animation_is_only_looked_for_once()
+{
+    AnimationCache cache(Animation::spriteCacheBudget);
+    CRGB *frame = new CRGB[ledCount()];
+
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_FALSE(cache.copyFrame("missing", 0, frame, matrixConfig));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, cache.misses());
+    TEST_ASSERT_EQUAL_UINT32(10, cache.missingFrames());
+
+    // Until it's cleared, in case the filesystem has changed
+    cache.clear();
+    TEST_ASSERT_FALSE(cache.copyFrame("missing", 0, frame, matrixConfig));
+    TEST_ASSERT_EQUAL_UINT32(2, cache.misses());
+
+    delete[] frame;
+}
+
+void test_oversized_animation_decodes_the_same_frames()
+{
+    AnimationCache cached(Animation::spriteCacheBudget);
+    // Smaller than a single frame, so nothing can ever be resident
+    AnimationCache uncached(sizeof(CRGB));
+
+    CRGB *expected = new CRGB[ledCount()];
+    CRGB *actual = new CRGB[ledCount()];
+    uint16_t frames = 0;
+
+    while (cached.copyFrame("amogus", frames, expected, matrixConfig))
+    {
+        memset((void *)actual, 0xAA, sizeof(CRGB) * ledCount());
+        TEST_ASSERT_TRUE(uncached.copyFrame("amogus", frames, actual, matrixConfig));
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(CRGB) * ledCount());
+        frames++;
+    }
+
+    TEST_ASSERT_TRUE(frames > 1);
+    TEST_ASSERT_FALSE(uncached.copyFrame("amogus", frames, actual, matrixConfig));
+    TEST_ASSERT_EQUAL_UINT32(1, uncached.missingFrames());
+
+    // Only the first lookup read and checked the whole container
+    TEST_ASSERT_EQUAL_UINT32(1, uncached.misses());
+    TEST_ASSERT_EQUAL_UINT32(0, uncached.usedBytes());
+
+    delete[] expected;
+    delete[] actual;
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_missing_animation_is_only_looked_for_once);
+    RUN_TEST(test_oversized_animation_decodes_the_same_frames);
+    return UNITY_END();
+}
@@ -0,0 +1,19 @@
+#include <unity.h>
+
+#include "FftBenchmark.h"
+
+// Holds FixedFFT to the limits in FftBenchmark.h: run with `pio test -e native`
+
+void test_every_size_is_within_limits()
+{
+    // Printed too, so a failure shows which size and by how much
+    Stream console(stdout);
+    TEST_ASSERT_TRUE(FftBenchmark::run(console));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_size_is_within_limits);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include <unity.h>
+
+#include <Native.h>
+
+#include <math.h>
+#include <vector>
+
+#include "LedOutput.h"
+
+// Drives LedOutput through a transport whose transfers only finish when the
+// test says so: run with `pio test -e native`
+
+namespace
+{
+    constexpr uint16_t LedCount = 8;
+
+    class FakeTransport : public LedTransport {
+        public:
+            bool begin(uint8_t pin) override { return true; }
+
+            void start(const uint32_t *words, uint16_t count) override
+            {
+                sent.push_back(std::vector<uint32_t>(words, words + count));
+                transferring = true;
+            }
+
+            bool busy() override { return transferring; }
+
+            std::vector<std::vector<uint32_t>> sent;
+            bool transferring = false;
+    };
+
+    const uint32_t frameTimeUs = LedCount * PinConstants::LED::PixelTimeUs +
+        PinConstants::LED::ResetTimeUs;
+
+    // GRB, so green is the top byte on the wire
+    uint32_t word(uint8_t red, uint8_t green, uint8_t blue)
+    {
+        return ((uint32_t)green << 24) | ((uint32_t)red << 16) | ((uint32_t)blue << 8);
+    }
+}
+
+void test_show_during_transfer_replaces_pending_frame()
+{
+    FakeTransport transport;
+    CRGB leds[LedCount] = {};
+    LedOutput output;
+    TEST_ASSERT_TRUE(output.begin(&transport, 0, leds, LedCount, OutputTransform()));
+
+    // Nothing on the wire yet, so the first frame goes straight out
+    leds[0] = CRGB(1, 0, 0);
+    output.show();
+    TEST_ASSERT_EQUAL_UINT32(1, transport.sent.size());
+
+    leds[0] = CRGB(2, 0, 0);
+    output.show();
+    leds[0] = CRGB(3, 0, 0);
+    output.show();
+    TEST_ASSERT_EQUAL_UINT32(1, transport.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(1, output.stats().sent);
+    TEST_ASSERT_EQUAL_UINT32(1, output.stats().replaced);
+
+    transport.transferring = false;
+    Native::advanceUs(frameTimeUs);
+    TEST_ASSERT_TRUE(output.update());
+
+    // Only the newest frame went out, and the first one was left alone
+    TEST_ASSERT_EQUAL_UINT32(2, transport.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(word(1, 0, 0), transport.sent[0][0]);
+    TEST_ASSERT_EQUAL_UINT32(word(3, 0, 0), transport.sent[1][0]);
+    TEST_ASSERT_EQUAL_UINT32(2, output.stats().sent);
+    TEST_ASSERT_FALSE(output.update());
+}
+
+void test_next_frame_waits_for_latch()
+{
+    FakeTransport transport;
+    CRGB leds[LedCount] = {};
+    LedOutput output;
+    output.begin(&transport, 0, leds, LedCount, OutputTransform());
+
+    output.show();
+    TEST_ASSERT_EQUAL_UINT32(1, transport.sent.size());
+
+    // DMA done only means the FIFO is loaded; the bits and latch are still going
+    transport.transferring = false;
+    output.show();
+    TEST_ASSERT_EQUAL_UINT32(1, transport.sent.size());
+
+    Native::advanceUs(frameTimeUs - 1);
+    TEST_ASSERT_FALSE(output.update());
+    TEST_ASSERT_EQUAL_UINT32(1, transport.sent.size());
+
+    Native::advanceUs(1);
+    TEST_ASSERT_TRUE(output.update());
+    TEST_ASSERT_EQUAL_UINT32(2, transport.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(0, output.stats().replaced);
+}
+
+void test_transform_is_applied_once()
+{
+    FakeTransport transport;
+    CRGB leds[LedCount] = {};
+    OutputTransform transform;
+    transform.gamma = 2.2f;
+    transform.correction = 0xFF80C0;
+    transform.maxBrightness = 200;
+
+    LedOutput output;
+    output.begin(&transport, 0, leds, LedCount, transform);
+
+    for (uint16_t i = 0; i < LedCount; i++)
+    {
+        leds[i] = CRGB(255 - 30 * i, 30 * i, 100 + 20 * i);
+    }
+
+    auto expected = [&](uint8_t value, uint8_t correction, uint8_t brightness) {
+        uint32_t gamma = (uint32_t)(powf(value / 255.0f, 2.2f) * 255.0f + 0.5f);
+        return (uint8_t)((gamma * (correction + 1) * (brightness + 1)) >> 16);
+    };
+
+    // Asked for above maxBrightness, so capped to it
+    output.show(255);
+
+    // Shown again, unchanged, to catch anything applied to the pixels themselves
+    transport.transferring = false;
+    Native::advanceUs(frameTimeUs);
+    output.show(255);
+
+    TEST_ASSERT_EQUAL_UINT32(2, transport.sent.size());
+    for (uint16_t i = 0; i < LedCount; i++)
+    {
+        TEST_ASSERT_TRUE(leds[i] == CRGB(255 - 30 * i, 30 * i, 100 + 20 * i));
+
+        uint32_t want = word(expected(leds[i].r, 0xFF, 200), expected(leds[i].g, 0x80, 200),
+            expected(leds[i].b, 0xC0, 200));
+        TEST_ASSERT_EQUAL_UINT32(want, transport.sent[0][i]);
+        TEST_ASSERT_EQUAL_UINT32(want, transport.sent[1][i]);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_show_during_transfer_replaces_pending_frame);
+    RUN_TEST(test_next_frame_waits_for_latch);
+    RUN_TEST(test_transform_is_applied_once);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <unity.h>
+
+#include "PatternVm.h"
+#include "Patterns.h"
+#include "ZoneView.h"
+
+// Renders every pattern and compares its frames against known hashes: run
+// with `pio test -e native` from connector_x, so the animations in data load
+
+namespace
+{
+    // Bitmap patterns only draw at 256, the 32x8 matrix
+    const uint16_t ledCounts[] = {1, 18, 93, 256};
+
+    const uint32_t color = 0x20A0F0;
+
+    // SineRoll as a program, so a loaded slot is covered as well as empty ones
+    const uint8_t sineRollProgram[] = {
+        (uint8_t)ProgramOp::Index,
+        (uint8_t)ProgramOp::Push16, 0xcc, 0x0c, // 65536 / 20
+        (uint8_t)ProgramOp::Mul,
+        (uint8_t)ProgramOp::State,
+        (uint8_t)ProgramOp::Push16, 0x00, 0x04, // 4 / 256 of a cycle
+        (uint8_t)ProgramOp::Mul,
+        (uint8_t)ProgramOp::Sub,
+        (uint8_t)ProgramOp::Sin,
+        (uint8_t)ProgramOp::Shade,
+        (uint8_t)ProgramOp::End,
+    };
+
+    struct Golden
+    {
+        PatternType type;
+        uint32_t hash;
+    };
+
+    // To accept a deliberate change, copy the new hash from the failure
+    const Golden goldens[] = {
+        {PatternType::None, 0x0afa6625},
+        {PatternType::SetAll, 0xa90c5b09},
+        {PatternType::Blink, 0x585acf15},
+        {PatternType::RGBFade, 0xd963c43d},
+        {PatternType::HackerMode, 0xe93db225},
+        {PatternType::Breathing, 0x8652ce5d},
+        {PatternType::SineRoll, 0xeb3a8643},
+        {PatternType::Chase, 0xc70498ed},
+        {PatternType::AngryEyes, 0x29a276a9},
+        {PatternType::HappyEyes, 0x2544784f},
+        {PatternType::BlinkingEyes, 0xb7f270b9},
+        {PatternType::SurprisedEyes, 0x306b98f3},
+        {PatternType::Amogus, 0xaf27c361},
+        {PatternType::Spectrum, 0x0f29e553},
+        {PatternType::OwOEyes, 0xcc343101},
+        {PatternType::Program0, 0xeb3a8643},
+        {PatternType::Program1, 0x4afc0285},
+        {PatternType::Program2, 0x4afc0285},
+        {PatternType::Program3, 0x4afc0285},
+    };
+
+    void hashBytes(uint32_t *hash, const void *data, size_t len)
+    {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (size_t i = 0; i < len; i++)
+        {
+            *hash = (*hash ^ bytes[i]) * 16777619u;
+        }
+    }
+
+    // The first few states, one from the middle and the last, at every LED
+    // count and in both directions, along with what render returned
+    uint32_t hashPattern(const Pattern &pattern)
+    {
+        uint32_t hash = 2166136261u;
+
+        for (uint16_t ledCount : ledCounts)
+        {
+            uint32_t states = pattern.numStates;
+            if (pattern.mode == PatternStateMode::LedCount)
+            {
+                states += ledCount;
+            }
+            states = std::max<uint32_t>(states, 1);
+
+            const uint32_t picked[] = {0, 1, 2, 3, states / 2, states - 1};
+
+            for (bool reversed : {false, true})
+            {
+                CRGB *leds = new CRGB[ledCount];
+                ZoneView strip(leds, 0, ledCount, reversed);
+
+                for (uint32_t state : picked)
+                {
+                    if (state >= states)
+                    {
+                        continue;
+                    }
+
+                    // As PatternZone does before every render
+                    strip.clear();
+                    bool drawn = pattern.render(strip, color, state, ledCount);
+
+                    hashBytes(&hash, &drawn, sizeof(drawn));
+                    hashBytes(&hash, leds, sizeof(CRGB) * ledCount);
+                }
+
+                delete[] leds;
+            }
+        }
+
+        return hash;
+    }
+}
+
+void test_every_pattern_has_a_golden()
+{
+    TEST_ASSERT_EQUAL_UINT32(sizeof(Animation::patterns) / sizeof(Animation::patterns[0]),
+        sizeof(goldens) / sizeof(goldens[0]));
+}
+
+void test_frames_match_goldens()
+{
+    programs[0].load(sineRollProgram, sizeof(sineRollProgram));
+
+    for (const Golden &golden : goldens)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "pattern %u", (uint8_t)golden.type);
+
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(golden.hash,
+            hashPattern(Animation::patterns[(uint8_t)golden.type]), name);
+    }
+
+    programs[0].clear();
+}
+
+void test_missing_frame_is_not_shown()
+{
+    // As if nothing had been uploaded
+    LittleFS.setRoot("missing");
+    animationCache.clear();
+
+    CRGB leds[256];
+    ZoneView strip(leds, 0, 256, false);
+    std::fill(leds, leds + 256, CRGB(CRGB::White));
+
+    uint32_t missing = animationCache.missingFrames();
+    TEST_ASSERT_FALSE(Animation::patterns[(uint8_t)PatternType::Amogus].render(strip, color, 0, 256));
+    TEST_ASSERT_EQUAL_UINT32(missing + 1, animationCache.missingFrames());
+
+    for (const CRGB &led : leds)
+    {
+        TEST_ASSERT_FALSE((bool)led);
+    }
+
+    LittleFS.setRoot("data");
+    animationCache.clear();
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_pattern_has_a_golden);
+    RUN_TEST(test_frames_match_goldens);
+    RUN_TEST(test_missing_frame_is_not_shown);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include <thread>
+
+#include "SpscRing.h"
+
+// Hammers SpscRing from two threads: run with `pio test -e native`
+
+namespace
+{
+    constexpr uint32_t ItemCount = 4000000;
+
+    // Small enough that the producer is always catching up with the consumer
+    constexpr uint32_t RingSize = 64;
+
+    // Larger than a word so a torn copy shows up as a bad check value
+    struct Item
+    {
+        uint32_t sequence;
+        uint32_t check;
+        uint8_t padding[24];
+    };
+
+    Item makeItem(uint32_t sequence)
+    {
+        Item item = {};
+        item.sequence = sequence;
+        item.check = ~sequence * 2654435761u;
+        for (uint8_t i = 0; i < sizeof(item.padding); i++)
+        {
+            item.padding[i] = sequence + i;
+        }
+        return item;
+    }
+
+    bool intact(const Item &item)
+    {
+        if (item.check != ~item.sequence * 2654435761u)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < sizeof(item.padding); i++)
+        {
+            if (item.padding[i] != (uint8_t)(item.sequence + i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    SpscRing<Item, RingSize> ring;
+
+    // Cycles through every way of adding items, retrying whichever one fails
+    void produce()
+    {
+        Item batch[RingSize];
+        uint32_t next = 0;
+        uint32_t turn = 0;
+
+        while (next < ItemCount)
+        {
+            switch (turn++ % 3)
+            {
+            case 0:
+                while (!ring.push(makeItem(next)))
+                {
+                    std::this_thread::yield();
+                }
+                next++;
+                break;
+
+            case 1:
+            {
+                // Up to the whole ring at once, so it also has to wait for empty
+                uint32_t count = std::min(1 + turn % RingSize, ItemCount - next);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    batch[i] = makeItem(next + i);
+                }
+                while (!ring.push(batch, count))
+                {
+                    std::this_thread::yield();
+                }
+                next += count;
+                break;
+            }
+
+            default:
+            {
+                Item *slot;
+                while ((slot = ring.claim()) == nullptr)
+                {
+                    std::this_thread::yield();
+                }
+                *slot = makeItem(next++);
+                ring.publish();
+                break;
+            }
+            }
+        }
+    }
+}
+
+void test_every_item_arrives_once_in_order()
+{
+    std::thread producer(produce);
+
+    uint32_t expected = 0;
+    uint32_t turn = 0;
+    uint32_t lost = 0;
+    uint32_t torn = 0;
+
+    while (expected < ItemCount)
+    {
+        Item item;
+
+        if (turn++ % 2 == 0)
+        {
+            if (!ring.pop(&item))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+        }
+        else
+        {
+            Item *front = ring.front();
+            if (front == nullptr)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            item = *front;
+            ring.release();
+        }
+
+        if (!intact(item))
+        {
+            torn++;
+        }
+        if (item.sequence != expected)
+        {
+            // Either a gap, a repeat or out of order; resync to keep counting
+            lost++;
+        }
+        expected = item.sequence + 1;
+    }
+
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, lost);
+    TEST_ASSERT_EQUAL_UINT32(ItemCount, expected);
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL_UINT32(RingSize, ring.highWater());
+}
+
+void test_bulk_push_is_all_or_nothing()
+{
+    SpscRing<uint32_t, 8> small;
+    uint32_t items[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    TEST_ASSERT_TRUE(small.push(items, 5));
+    TEST_ASSERT_FALSE(small.push(items, 4));
+    TEST_ASSERT_EQUAL_UINT32(5, small.size());
+    TEST_ASSERT_EQUAL_UINT32(4, small.overflows());
+
+    TEST_ASSERT_TRUE(small.push(items + 5, 3));
+    TEST_ASSERT_NULL(small.claim());
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        uint32_t item;
+        TEST_ASSERT_TRUE(small.pop(&item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+    TEST_ASSERT_NULL(small.front());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bulk_push_is_all_or_nothing);
+    RUN_TEST(test_every_item_arrives_once_in_order);
+    return UNITY_END();
+}
@@ -0,0 +1,109 @@
+#include <unity.h>
+
+#include <Native.h>
+
+#include "LedOutput.h"
+#include "PatternZone.h"
+
+// Stalls every PatternZone::updateZones by several pattern delays, as a slow
+// render or show would: run with `pio test -e native`
+
+namespace
+{
+    constexpr uint16_t ZoneLeds = 10;
+    constexpr uint16_t DelayMs = 100;
+    // Three and a half delays, so a timed zone has to skip states and land
+    // between them
+    constexpr uint32_t StallMs = 350;
+    constexpr uint16_t Frames = 40;
+
+    // RGBFade, so states don't repeat for a while
+    constexpr uint16_t StateCount = 256;
+
+    class IdleTransport : public LedTransport {
+        public:
+            bool begin(uint8_t pin) override { return true; }
+            void start(const uint32_t *words, uint16_t count) override {}
+            bool busy() override { return false; }
+    };
+
+    IdleTransport transport;
+    CRGB leds[2 * ZoneLeds];
+
+    uint16_t stateOf(PatternZone &port, uint8_t zone)
+    {
+        PortStatus status;
+        port.getStatus(&status);
+        return status.zones[zone].state;
+    }
+
+    bool doneOf(PatternZone &port, uint8_t zone)
+    {
+        PortStatus status;
+        port.getStatus(&status);
+        return status.zones[zone].done;
+    }
+}
+
+void test_timed_zone_keeps_time_while_counted_zone_falls_behind()
+{
+    PatternZone port(0, 255, leds, 2 * ZoneLeds, 2, 0);
+
+    // Zone 0 counts updates, zone 1 takes its state from the time
+    port.setRunZone(0, false);
+    port.setPattern(PatternType::RGBFade, DelayMs);
+    port.setRunZone(1, false);
+    port.setPattern(PatternType::RGBFade, DelayMs, false, true);
+
+    uint32_t startMs = timebase.nowMs();
+    uint16_t countedStart = stateOf(port, 0);
+    uint16_t lastTimed = stateOf(port, 1);
+
+    for (uint16_t frame = 1; frame <= Frames; frame++)
+    {
+        Native::advanceUs(StallMs * 1000);
+        port.updateZones();
+
+        uint32_t elapsedMs = timebase.nowMs() - startMs;
+        uint16_t timed = stateOf(port, 1);
+
+        TEST_ASSERT_EQUAL_UINT32((elapsedMs / DelayMs) % StateCount, timed);
+        // Skipped ahead over the states it was too late for
+        TEST_ASSERT_TRUE((uint16_t)(timed - lastTimed + StateCount) % StateCount >= 3);
+        lastTimed = timed;
+
+        // One state per update however late, so it falls further behind every frame
+        TEST_ASSERT_EQUAL_UINT32((countedStart + frame) % StateCount, stateOf(port, 0));
+    }
+}
+
+void test_timed_one_shot_ends_on_wall_time()
+{
+    PatternZone port(0, 255, leds, 2 * ZoneLeds, 2, 0);
+
+    // Blink has two states, so one stall takes it past its end
+    port.setRunZone(1, false);
+    port.setPattern(PatternType::Blink, DelayMs, true, true);
+
+    Native::advanceUs(StallMs * 1000);
+    port.updateZones();
+
+    // The last state still gets shown, however late
+    TEST_ASSERT_EQUAL_UINT32(1, stateOf(port, 1));
+    TEST_ASSERT_FALSE(doneOf(port, 1));
+
+    port.updateZones();
+    TEST_ASSERT_TRUE(doneOf(port, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, stateOf(port, 1));
+}
+
+int main()
+{
+    // The port the zones show on, so they have somewhere to send frames
+    ledOutputs[0].begin(&transport, 0, leds, 2 * ZoneLeds, OutputTransform());
+
+    UNITY_BEGIN();
+    RUN_TEST(test_timed_zone_keeps_time_while_counted_zone_falls_behind);
+    RUN_TEST(test_timed_one_shot_ends_on_wall_time);
+    return UNITY_END();
+}
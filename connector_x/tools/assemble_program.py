@@ -0,0 +1,157 @@
+"""Assemble a pattern program into the bytecode run by PatternVm.
+
+Usage:
+    python tools/assemble_program.py sine_roll.txt data/program0.pvm
+    python tools/assemble_program.py sine_roll.txt --slot 0 [--time MS]
+
+Programs are whitespace separated instructions, with # starting a comment.
+A bare number pushes it, using PUSH8 or PUSH16 as needed. Files written to
+data/ as program<slot>.pvm are loaded at startup; --slot instead prints the
+LoadProgram writes that send the program over I2C, in the simulator's script
+format.
+
+The opcodes and stack rules must match PatternVm.h.
+"""
+
+import argparse
+import sys
+
+# name: (opcode, pops, pushes)
+OPS = {
+    "END": (0, 1, 0),
+    "PUSH8": (1, 0, 1),
+    "PUSH16": (2, 0, 1),
+    "INDEX": (3, 0, 1),
+    "COUNT": (4, 0, 1),
+    "STATE": (5, 0, 1),
+    "TIME": (6, 0, 1),
+    "RED": (7, 0, 1),
+    "GREEN": (8, 0, 1),
+    "BLUE": (9, 0, 1),
+    "DUP": (10, 1, 2),
+    "DROP": (11, 1, 0),
+    "SWAP": (12, 2, 2),
+    "OVER": (13, 2, 3),
+    "ADD": (14, 2, 1),
+    "SUB": (15, 2, 1),
+    "MUL": (16, 2, 1),
+    "DIV": (17, 2, 1),
+    "MOD": (18, 2, 1),
+    "SCALE": (19, 2, 1),
+    "SHL": (20, 2, 1),
+    "SHR": (21, 2, 1),
+    "AND": (22, 2, 1),
+    "OR": (23, 2, 1),
+    "XOR": (24, 2, 1),
+    "MIN": (25, 2, 1),
+    "MAX": (26, 2, 1),
+    "LT": (27, 2, 1),
+    "GT": (28, 2, 1),
+    "EQ": (29, 2, 1),
+    "SELECT": (30, 3, 1),
+    "SIN": (31, 1, 1),
+    "TRI": (32, 1, 1),
+    "RGB": (33, 3, 1),
+    "SHADE": (34, 1, 1),
+}
+
+MAX_SIZE = 128
+STACK_DEPTH = 16
+CHUNK_SIZE = 32
+LOAD_PROGRAM = 24
+
+
+def parse_int(token):
+    try:
+        return int(token, 0)
+    except ValueError:
+        sys.exit(f"Expected a number, got {token}")
+
+
+def push(value):
+    if 0 <= value <= 0xFF:
+        return bytes([OPS["PUSH8"][0], value])
+    if -0x8000 <= value <= 0x7FFF:
+        return bytes([OPS["PUSH16"][0]]) + (value & 0xFFFF).to_bytes(2, "little")
+    sys.exit(f"{value} doesn't fit in 16 bits")
+
+
+def assemble(source):
+    tokens = []
+    for line in source.splitlines():
+        tokens += line.split("#", 1)[0].split()
+
+    code = bytearray()
+    depth = 0
+    i = 0
+    while i < len(tokens):
+        name = tokens[i].upper()
+        i += 1
+
+        if name not in OPS:
+            code += push(parse_int(name))
+            pops, pushes = 0, 1
+        elif name in ("PUSH8", "PUSH16"):
+            if i == len(tokens):
+                sys.exit(f"{name} needs a value")
+            value = parse_int(tokens[i])
+            i += 1
+            if name == "PUSH8":
+                if not 0 <= value <= 0xFF:
+                    sys.exit(f"PUSH8 {value} is out of range")
+                code += bytes([OPS[name][0], value])
+            else:
+                if not -0x8000 <= value <= 0x7FFF:
+                    sys.exit(f"PUSH16 {value} is out of range")
+                code += bytes([OPS[name][0]]) + (value & 0xFFFF).to_bytes(2, "little")
+            pops, pushes = 0, 1
+        else:
+            opcode, pops, pushes = OPS[name]
+            code.append(opcode)
+
+        if depth < pops:
+            sys.exit(f"{name} needs {pops} values but the stack has {depth}")
+        depth += pushes - pops
+        if depth > STACK_DEPTH:
+            sys.exit(f"Stack deeper than {STACK_DEPTH} at {name}")
+
+    if not code or code[-1] != OPS["END"][0]:
+        if depth != 1:
+            sys.exit(f"Program must leave exactly one color, it leaves {depth}")
+        code.append(OPS["END"][0])
+    elif depth != 0:
+        sys.exit("Program must leave exactly one color at END")
+
+    if len(code) > MAX_SIZE:
+        sys.exit(f"Program is {len(code)} bytes, the limit is {MAX_SIZE}")
+
+    return bytes(code)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="program text")
+    parser.add_argument("output", nargs="?", help=".pvm file to write, such as data/program0.pvm")
+    parser.add_argument("--slot", type=int, help="print LoadProgram writes for this slot instead")
+    parser.add_argument("--time", type=int, default=0, help="time of the writes in the script, in ms")
+    args = parser.parse_args()
+
+    with open(args.source) as f:
+        code = assemble(f.read())
+
+    if args.slot is not None:
+        for offset in range(0, len(code), CHUNK_SIZE):
+            chunk = code[offset:offset + CHUNK_SIZE]
+            last = offset + CHUNK_SIZE >= len(code)
+            frame = bytes([LOAD_PROGRAM, args.slot, offset, last]) + chunk
+            print(f"{args.time} w {frame.hex(' ')}")
+    elif args.output:
+        with open(args.output, "wb") as f:
+            f.write(code)
+        print(f"{args.source}: {len(code)} bytes")
+    else:
+        parser.error("give an output file or --slot")
+
+
+if __name__ == "__main__":
+    main()
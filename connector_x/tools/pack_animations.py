@@ -0,0 +1,184 @@
+"""Pack animation directories of N.bmp files into single .anim containers.
+
+Usage:
+    python tools/pack_animations.py animations data [--delay MS] [--encoding NAME]
+
+Each subdirectory of the source directory becomes <name>.anim in the output
+directory. Frames must be 16-bit (RGB565) bitmaps named 0.bmp, 1.bmp, ...
+Per-frame delays can be given in an optional delays.txt holding one delay in
+milliseconds per line; otherwise --delay is used for every frame.
+
+The layout must match AnimationContainer.h.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"CXAN"
+VERSION = 1
+
+ENCODING_RAW565 = 0
+ENCODING_INDEXED = 1
+ENCODING_INDEXED_RLE = 2
+
+ENCODINGS = {
+    "raw": ENCODING_RAW565,
+    "indexed": ENCODING_INDEXED,
+    "rle": ENCODING_INDEXED_RLE,
+}
+
+HEADER_FORMAT = "<4sBBHHHHHII"
+FRAME_ENTRY_FORMAT = "<IHH"
+MAX_RUN = 255
+
+
+def read_bitmap(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    image_offset = struct.unpack_from("<I", data, 10)[0]
+    width, height, _, bits_per_pixel = struct.unpack_from("<iiHH", data, 18)
+
+    if bits_per_pixel != 16:
+        raise ValueError(f"{path}: expected a 16-bit bitmap, got {bits_per_pixel}")
+
+    width = abs(width)
+    height = abs(height)
+    # Rows are kept in file order, exactly as the firmware always drew them
+    count = width * height
+    pixels = list(struct.unpack_from(f"<{count}H", data, image_offset))
+
+    return width, height, pixels
+
+
+def encode_rle(indexes):
+    out = bytearray()
+    i = 0
+
+    while i < len(indexes):
+        run = 1
+        while i + run < len(indexes) and run < MAX_RUN and indexes[i + run] == indexes[i]:
+            run += 1
+
+        out += bytes((run, indexes[i]))
+        i += run
+
+    return bytes(out)
+
+
+def encode_frames(frames, encoding):
+    palette = []
+
+    if encoding != ENCODING_RAW565:
+        palette = sorted({pixel for frame in frames for pixel in frame})
+        if len(palette) > 256:
+            return None, None
+
+    lookup = {color: index for index, color in enumerate(palette)}
+    encoded = []
+
+    for frame in frames:
+        if encoding == ENCODING_RAW565:
+            encoded.append(struct.pack(f"<{len(frame)}H", *frame))
+        elif encoding == ENCODING_INDEXED:
+            encoded.append(bytes(lookup[pixel] for pixel in frame))
+        else:
+            encoded.append(encode_rle([lookup[pixel] for pixel in frame]))
+
+    return palette, encoded
+
+
+def build_container(width, height, frames, delays, encoding):
+    palette, encoded = encode_frames(frames, encoding)
+    if encoded is None:
+        return None
+
+    table = bytearray()
+    offset = 0
+    for data, delay in zip(encoded, delays):
+        table += struct.pack(FRAME_ENTRY_FORMAT, offset, len(data), delay)
+        offset += len(data)
+
+    body = bytes(table) + struct.pack(f"<{len(palette)}H", *palette) + b"".join(encoded)
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, encoding, width, height,
+                         len(frames), len(palette), 0, len(body),
+                         zlib.crc32(body) & 0xFFFFFFFF)
+
+    return header + body
+
+
+def read_delays(directory, frame_count, default_delay):
+    path = os.path.join(directory, "delays.txt")
+    if not os.path.exists(path):
+        return [default_delay] * frame_count
+
+    with open(path) as f:
+        delays = [int(line) for line in f if line.strip()]
+
+    if len(delays) != frame_count:
+        raise ValueError(f"{path}: expected {frame_count} delays, got {len(delays)}")
+
+    return delays
+
+
+def pack_directory(directory, default_delay, encoding):
+    frames = []
+    width = height = None
+
+    while os.path.exists(os.path.join(directory, f"{len(frames)}.bmp")):
+        w, h, pixels = read_bitmap(os.path.join(directory, f"{len(frames)}.bmp"))
+        if width is not None and (w, h) != (width, height):
+            raise ValueError(f"{directory}: frame {len(frames)} is {w}x{h}, expected {width}x{height}")
+
+        width, height = w, h
+        frames.append(pixels)
+
+    if not frames:
+        return None
+
+    delays = read_delays(directory, len(frames), default_delay)
+
+    if encoding is not None:
+        return build_container(width, height, frames, delays, encoding)
+
+    # Pick whichever encoding is smallest
+    candidates = [build_container(width, height, frames, delays, e) for e in ENCODINGS.values()]
+    return min((c for c in candidates if c is not None), key=len)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="directory holding one subdirectory per animation")
+    parser.add_argument("output", help="directory to write .anim files to, usually data/")
+    parser.add_argument("--delay", type=int, default=0,
+                        help="frame delay in ms when there is no delays.txt; 0 uses the pattern's delay")
+    parser.add_argument("--encoding", choices=ENCODINGS.keys(),
+                        help="force an encoding instead of picking the smallest")
+    args = parser.parse_args()
+
+    encoding = ENCODINGS[args.encoding] if args.encoding else None
+    os.makedirs(args.output, exist_ok=True)
+
+    for name in sorted(os.listdir(args.source)):
+        directory = os.path.join(args.source, name)
+        if not os.path.isdir(directory):
+            continue
+
+        container = pack_directory(directory, args.delay, encoding)
+        if container is None:
+            print(f"Skipping {name}: no frames", file=sys.stderr)
+            continue
+
+        path = os.path.join(args.output, f"{name}.anim")
+        with open(path, "wb") as f:
+            f.write(container)
+
+        print(f"{name}: {struct.unpack_from('<H', container, 10)[0]} frames, "
+              f"encoding {container[5]}, {len(container)} bytes")
+
+
+if __name__ == "__main__":
+    main()